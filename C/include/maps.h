@@ -11,6 +11,7 @@
 #include <string.h>
 #include <math.h>
 #include <time.h>
+#include <stdint.h>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -26,13 +27,10 @@
 
 /* Maximum limits */
 #define MAX_STATES 60
-#define MAX_PRECINCTS 50000
 #define MAX_DISTRICTS 100
-#define MAX_PLANS 100
 #define MAX_PATH_LEN 512
 #define MAX_NAME_LEN 128
 #define MAX_ID_LEN 64
-#define MAX_NEIGHBORS 100
 
 /* Fairness presets */
 typedef enum {
@@ -51,12 +49,70 @@ typedef struct {
     const char* description;
 } FairnessConfig;
 
+/* Automap phase 3 optimizer */
+typedef enum {
+    OPTIMIZER_GREEDY = 0,   /* Keep only improving border moves */
+    OPTIMIZER_ANNEAL        /* Simulated annealing, then a greedy pass */
+} OptimizerMode;
+
+/* How automap builds the plan phase 3 starts from */
+typedef enum {
+    INITIAL_COUNTIES = 0,   /* Whole counties, then region growing */
+    INITIAL_MULTILEVEL      /* Multilevel graph partitioning */
+} InitialMode;
+
+/* Simulated annealing schedule; zero fields pick the defaults */
+typedef struct {
+    long steps;             /* Proposal budget, 0 = a multiple of the precinct count */
+    double seconds;         /* Wall-clock budget, 0 = none */
+    double startTemp;       /* 0 = calibrate from sampled moves */
+    double endTemp;         /* 0 = startTemp / 100 */
+    uint32_t seed;
+} AnnealSettings;
+
+/* Exit codes of a batch run (batch.c) */
+typedef enum {
+    BATCH_OK = 0,
+    BATCH_USAGE = 1,           /* Bad command line */
+    BATCH_LOAD_FAILED = 2,     /* State list or precinct data could not be loaded */
+    BATCH_AUTOMAP_FAILED = 3,
+    BATCH_WRITE_FAILED = 4     /* Plan or metrics file could not be written */
+} BatchStatus;
+
+/* Job description for "run" on the command line */
+typedef struct {
+    char state[8];
+    int numDistricts;          /* 0 = the state's default */
+    FairnessPreset preset;
+    double customTarget;       /* Dem share 0-1, 0 = use the preset */
+    int starts;                /* Automap random starts, 1 = single deterministic run */
+    char planName[MAX_NAME_LEN];
+    char planId[MAX_ID_LEN];   /* Empty = generated */
+    char outPath[MAX_PATH_LEN];      /* Plan JSON, empty = none */
+    char metricsPath[MAX_PATH_LEN];  /* Metrics JSON, empty = none */
+    int save;                  /* Also save into the state's plans directory */
+} BatchOptions;
+
+/* Rule for deciding that two precincts are neighbors */
+typedef enum {
+    ADJACENCY_ROOK = 0,   /* Polygons share a boundary edge */
+    ADJACENCY_QUEEN       /* Polygons share an edge or a single vertex */
+} AdjacencyMode;
+
 /* Coordinate point */
 typedef struct {
     double x;
     double y;
 } Point;
 
+/* Axis-aligned bounding box */
+typedef struct {
+    double minX;
+    double minY;
+    double maxX;
+    double maxY;
+} BoundingBox;
+
 /* State metadata */
 typedef struct {
     char code[8];
@@ -65,21 +121,115 @@ typedef struct {
     int defaultNumDistricts;
 } State;
 
-/* Precinct data */
+/* Precinct descriptive data; counts and assignments live in AppState columns */
 typedef struct {
     int index;
     char id[MAX_ID_LEN];
-    int population;
-    int dem;
-    int rep;
-    char county[MAX_NAME_LEN];
     Point centroid;
+    BoundingBox bounds;
     double demShare;
-    int district;
-    int neighbors[MAX_NEIGHBORS];
-    int neighborCount;
 } Precinct;
 
+/* County names interned to dense ids in first-seen order */
+typedef struct {
+    char (*names)[MAX_NAME_LEN];  /* names[id] */
+    int count;
+    int capacity;
+    int* slots;                   /* Open-addressing hash of name -> id, -1 = empty */
+    int slotCount;
+} CountyTable;
+
+/* Precinct adjacency graph in compressed sparse row form */
+typedef struct {
+    int* offsets;      /* nodeCount + 1 row offsets into neighbors */
+    int* neighbors;    /* Neighbor precinct indices */
+    double* weights;   /* Shared boundary length per entry, or NULL */
+    int nodeCount;
+    int edgeCount;     /* Directed entries (twice the undirected edges) */
+    int borrowed;      /* Arrays point into a cache mapping and are not freed */
+} AdjacencyGraph;
+
+/* Uniform grid over precinct centroids and bounding boxes (spatial.c) */
+typedef struct {
+    double minX;
+    double minY;
+    double cellSize;
+    int cols;
+    int rows;
+    int count;
+    int* cellStart;    /* cols * rows + 1 offsets into items */
+    int* items;        /* Precincts bucketed by centroid cell */
+    int* boxStart;     /* cols * rows + 1 offsets into boxItems */
+    int* boxItems;     /* Precincts bucketed by every cell their box overlaps */
+    int* largeItems;   /* Precincts with boxes too large to bucket */
+    int largeCount;
+} SpatialIndex;
+
+/* Running per-district totals, kept in step with every assignment (ledger.c).
+   Slot 0 collects unassigned precincts and any district outside 1..MAX_DISTRICTS. */
+typedef struct {
+    int population[MAX_DISTRICTS + 1];
+    int dem[MAX_DISTRICTS + 1];
+    int rep[MAX_DISTRICTS + 1];
+    int precinctCount[MAX_DISTRICTS + 1];
+    int countyCount[MAX_DISTRICTS + 1];   /* Distinct counties with a precinct in the district */
+    int* countyMembers;                   /* [district * countyTotal + county] precinct counts */
+    int countyTotal;
+} DistrictLedger;
+
+/* Contiguity checks for single-precinct moves (contiguity.c) */
+typedef struct {
+    const AdjacencyGraph* graph;
+    int precinctCount;
+    int* stamp;                /* Search marks, compared against generation */
+    int* queue;
+    int generation;
+    int* disc;                 /* Tarjan discovery order */
+    int* low;
+    int* parent;
+    int* cursor;               /* Next adjacency entry to visit */
+    int* cutStamp;             /* Cache token an isCut flag was computed under */
+    char* isCut;               /* Articulation point of its district piece */
+    int cacheToken[MAX_DISTRICTS + 1];  /* 0 = district changed since last computed */
+    int nextToken;
+    
+    /* How queries were answered */
+    long localHits;
+    long cacheHits;
+    long searchHits;
+    long articulationRuns;
+} ContiguityChecker;
+
+/* A precinct that could move to an adjacent district (border.c) */
+typedef struct {
+    int precinct;
+    int district;
+    int version;       /* Precinct's version when queued; stale once it changes */
+} BorderCandidate;
+
+/* Precincts on a district boundary, maintained as precincts move (border.c) */
+typedef struct {
+    uint64_t* bits;            /* Bit i set when precinct i touches another district */
+    int* version;              /* Per-precinct version, bumped on every refresh */
+    BorderCandidate* queue;    /* FIFO worklist of candidate moves */
+    int head;
+    int tail;
+    int capacity;
+    int precinctCount;
+} BorderSet;
+
+/* Open-addressing hash from precinct id to precinct index */
+typedef struct {
+    int* slots;        /* Precinct index, -1 = empty */
+    int slotCount;     /* Power of two, at least twice the precinct count */
+} PrecinctIdIndex;
+
+/* Return nonzero to accept a precinct in a spatial query */
+typedef int (*SpatialFilter)(int precinct, void* ctx);
+
+/* Incremental builder for polygon-based adjacency (topology.c) */
+typedef struct TopologyBuilder TopologyBuilder;
+
 /* District statistics */
 typedef struct {
     int districtId;
@@ -94,6 +244,16 @@ typedef struct {
     int countyCount;
 } DistrictStats;
 
+/* Read-only memory mapping of a whole file */
+typedef struct {
+    const unsigned char* data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+} MappedFile;
+
 /* Plan data */
 typedef struct {
     char state[8];
@@ -105,6 +265,57 @@ typedef struct {
     char lastUpdated[32];
 } Plan;
 
+/* Headline metrics of one plan (metrics.c) */
+typedef struct {
+    int demSeats;              /* Districts with more Dem than Rep votes */
+    double efficiencyGap;      /* Percent, positive favors R */
+    double maxDeviation;       /* Percent from the ideal district population */
+    double compactness;        /* Mean Polsby-Popper score */
+} PlanSummary;
+
+/* One saved plan as recorded in the state's plan manifest (manifest.c) */
+typedef struct {
+    char planId[MAX_ID_LEN];
+    char name[MAX_NAME_LEN];
+    char fileName[MAX_ID_LEN + 8];  /* Plan file in the state's plans directory */
+    char lastUpdated[32];
+    int64_t fileSize;          /* Plan file size and mtime when recorded */
+    int64_t fileMtime;
+    int32_t numDistricts;
+    int32_t hasSummary;        /* 0 when the plan could not be scored */
+    PlanSummary summary;
+    uint64_t contentHash;      /* Hash of a binary plan's packed districts */
+} PlanListing;
+
+/* A manual move, as kept for undo and redo */
+typedef struct {
+    int precinct;
+    int from;
+    int to;
+} JournalMove;
+
+/* Base plan rewrite running in the background (journal.c) */
+typedef struct JournalCompaction JournalCompaction;
+
+/* Append-only log of manual assignments made on top of the saved plan file
+   (journal.c); inactive while file is NULL */
+typedef struct {
+    FILE* file;
+    char path[MAX_PATH_LEN];
+    char basePath[MAX_PATH_LEN];
+    uint64_t baseHash;         /* contentHash of the base plan file */
+    uint32_t nextSequence;
+    long recordCount;          /* Records in the file */
+    int pending;               /* Records written since the last sync */
+    JournalMove* undo;
+    int undoCount;
+    int undoCapacity;
+    JournalMove* redo;
+    int redoCount;
+    int redoCapacity;
+    JournalCompaction* compaction;
+} AssignmentJournal;
+
 /* Application state */
 typedef struct {
     char dataDir[MAX_PATH_LEN];
@@ -113,54 +324,239 @@ typedef struct {
     
     /* Current loaded state */
     State* currentState;
-    Precinct precincts[MAX_PRECINCTS];
+    Precinct* precincts;        /* Heap store, grown to fit the loaded state */
     int precinctCount;
+    int precinctCapacity;
+    
+    /* Hot columns, indexed like precincts[] */
+    int* population;
+    int* dem;
+    int* rep;
+    int* district;              /* Working assignment, 0 = unassigned */
+    int* countyId;              /* Index into counties.names */
+    CountyTable counties;
+    
+    AdjacencyMode adjacencyMode;
+    AdjacencyGraph adjacency;   /* Neighbors of precinct i: neighbors[offsets[i] .. offsets[i + 1]) */
+    SpatialIndex spatial;
+    PrecinctIdIndex idIndex;
+    DistrictLedger ledger;      /* Totals for the district[] column */
+    ContiguityChecker contiguity;  /* Follows the district[] column */
+    MappedFile cacheMap;        /* Precinct cache backing borrowed arrays */
+    
+    /* Automap settings */
+    InitialMode initialMode;
+    OptimizerMode optimizer;
+    AnnealSettings anneal;
     
     /* Current plan */
     Plan currentPlan;
     int hasPlan;
+    AssignmentJournal journal;  /* Manual edits since the plan file was written */
     
-    /* Plans list */
-    char planIds[MAX_PLANS][MAX_ID_LEN];
-    char planNames[MAX_PLANS][MAX_NAME_LEN];
+    /* Saved plans of the current state, from its plan manifest */
+    PlanListing* plans;
     int planCount;
+    int planCapacity;
 } AppState;
 
+/* ReCom chain state (recom.c); scratch arrays are indexed locally over the
+   merged region of the current step */
+typedef struct {
+    const AppState* app;
+    int* district;             /* Chain state */
+    DistrictLedger ledger;
+    int numDistricts;
+    int idealPop;
+    double tolerance;
+    uint32_t rng;
+    
+    int* local;                /* Precinct -> local index, -1 outside the region */
+    int* nodes;                /* Local index -> precinct */
+    int* parent;               /* Spanning tree parent, -1 at the root */
+    int* next;                 /* Wilson's random walk successor */
+    char* inTree;
+    int* order;                /* Root-first tree order */
+    int* childStart;           /* Children in CSR form */
+    int* children;
+    int* subPop;               /* Population of each node's subtree */
+    int* cuts;                 /* Balanced cuts as node * 2 + side given to a */
+    char* side;                /* 1 inside the cut subtree */
+    
+    /* Step outcomes */
+    long accepted;
+    long noBalancedCut;
+    long partialMerges;        /* Steps whose region left detached pieces behind */
+    long noPair;
+} RecomChain;
+
 /* Global fairness presets */
 extern FairnessConfig FAIRNESS_PRESETS[5];
 
 /* Function declarations - states.c */
 int load_states_list(AppState* app);
 int load_state_data(AppState* app, const char* stateCode);
+void unload_state_data(AppState* app);
+int reserve_precincts(AppState* app, int count);
+int intern_county(CountyTable* table, const char* name);
+void free_county_table(CountyTable* table);
+int build_precinct_id_index(AppState* app);
+void free_precinct_id_index(PrecinctIdIndex* index);
+int find_precinct(const AppState* app, const char* id);
 void print_states_list(AppState* app);
 
+/* Function declarations - cache.c */
+int load_precinct_cache(AppState* app, const char* geoPath);
+int save_precinct_cache(AppState* app, const char* geoPath);
+
+/* Function declarations - topology.c */
+TopologyBuilder* topology_create(AdjacencyMode mode, int recordLengths);
+int topology_add_ring(TopologyBuilder* builder, int precinct, const double* coords, int pointCount);
+int topology_build(TopologyBuilder* builder, int nodeCount, AdjacencyGraph* graph);
+void topology_free(TopologyBuilder* builder);
+void free_adjacency_graph(AdjacencyGraph* graph);
+
+/* Function declarations - spatial.c */
+int build_spatial_index(SpatialIndex* idx, const AppState* app);
+void free_spatial_index(SpatialIndex* idx);
+int spatial_query_radius(const SpatialIndex* idx, const AppState* app, double x, double y,
+                         double radius, int* out, int maxOut);
+int spatial_k_nearest(const SpatialIndex* idx, const AppState* app, double x, double y, int k,
+                      SpatialFilter filter, void* ctx, int* out, double* outDist);
+int spatial_query_box(const SpatialIndex* idx, const AppState* app, const BoundingBox* box,
+                      int* out, int maxOut);
+int spatial_locate(const SpatialIndex* idx, const AppState* app, double x, double y);
+
+/* Function declarations - ledger.c */
+int ledger_rebuild(DistrictLedger* ledger, const AppState* app, const int* district);
+void ledger_free(DistrictLedger* ledger);
+void ledger_move(DistrictLedger* ledger, const AppState* app, int precinct, int from, int to);
+void assign_precinct(AppState* app, int precinct, int district);
+int clear_assignments(AppState* app);
+int sync_ledger(AppState* app);
+
+/* Function declarations - contiguity.c */
+int contiguity_init(ContiguityChecker* c, const AppState* app);
+void contiguity_free(ContiguityChecker* c);
+void contiguity_moved(ContiguityChecker* c, int from, int to);
+int contiguity_removal_ok(ContiguityChecker* c, const int* district, int precinct);
+int contiguity_addition_ok(const ContiguityChecker* c, const DistrictLedger* ledger,
+                           const int* district, int precinct, int to);
+
+/* Function declarations - border.c */
+int border_init(BorderSet* set, const AppState* app, const int* district);
+void border_free(BorderSet* set);
+int border_contains(const BorderSet* set, int precinct);
+int border_next(BorderSet* set, BorderCandidate* out);
+int border_moved(BorderSet* set, const AppState* app, const int* district, int precinct);
+
 /* Function declarations - plans.c */
 int load_plans_list(AppState* app, const char* stateCode);
 int load_plan(AppState* app, const char* stateCode, const char* planId);
 int save_plan(AppState* app);
+int saved_plan_exists(AppState* app, const char* planId);
+int import_plan_json(AppState* app, const char* path);
+int export_plan_json(AppState* app, const char* path);
 void create_new_plan(AppState* app, const char* name);
 void print_plans_list(AppState* app);
 
+/* Function declarations - planfile.c */
+int read_plan_info(const char* path, PlanListing* info);
+int plan_file_matches(const AppState* app, const char* path, const int* district);
+int read_plan_assignment(const AppState* app, const char* path, int* district, PlanListing* info);
+int write_plan_file(const AppState* app, const Plan* plan, const int* district, const char* path,
+                    uint64_t* contentHash);
+int save_plan_binary(AppState* app, const char* path);
+int load_plan_binary(AppState* app, const char* path);
+
+/* Function declarations - manifest.c */
+int refresh_plan_manifest(AppState* app, const char* stateCode, int rebuild);
+int record_saved_plan(AppState* app, const char* planPath);
+
+/* Function declarations - journal.c */
+int journal_open(AppState* app, int create);
+int journal_attach(AppState* app);
+void journal_cancel_compaction(AppState* app);
+int journal_assign(AppState* app, int precinct, int district);
+int journal_undo(AppState* app, JournalMove* move);
+int journal_redo(AppState* app, JournalMove* move);
+int journal_sync(AppState* app);
+int journal_rebase(AppState* app);
+void journal_close(AppState* app);
+
 /* Function declarations - metrics.c */
 void compute_district_stats(AppState* app, DistrictStats* stats, int numDistricts);
 void print_metrics(AppState* app);
 double calculate_compactness(double area, double perimeter);
+void summarize_plan(const AppState* app, const int* district, const DistrictLedger* ledger,
+                    int numDistricts, PlanSummary* out);
 
 /* Function declarations - automap.c */
 int generate_automap(AppState* app, int numDistricts, FairnessPreset preset, double customTarget);
+int generate_automap_multistart(AppState* app, int numDistricts, FairnessPreset preset,
+                                double customTarget, int starts, uint32_t seed);
 void print_automap_summary(AppState* app);
 
+/* Function declarations - multilevel.c */
+int multilevel_partition(const AppState* app, int numDistricts, int* district, uint32_t seed,
+                         int verbose);
+
+/* Function declarations - recom.c */
+int recom_plan_ready(const AppState* app);
+int recom_init(RecomChain* chain, const AppState* app, double tolerance, uint32_t seed,
+               uint32_t stream);
+void recom_free(RecomChain* chain);
+int recom_step(RecomChain* chain);
+int run_recom_chain(AppState* app, int steps, double tolerance, int recordEvery,
+                    uint32_t seed, const char* outputPath);
+
+/* Function declarations - ensemble.c */
+int run_ensemble(AppState* app, int plans, int burnIn, int thin, double tolerance,
+                 uint32_t seed, const char* outputPath);
+
+/* Function declarations - batch.c */
+int batch_capture_stdout(void);
+int batch_usage_error(const char* message);
+int run_batch(AppState* app, const BatchOptions* options);
+
 /* Function declarations - utils.c */
 int ensure_directory(const char* path);
 int file_exists(const char* path);
 char* trim_string(char* str);
 void get_timestamp(char* buffer, size_t size);
 int parse_int(const char* str, int defaultVal);
+int sync_file(FILE* file);
+int replace_file(const char* from, const char* to);
+uint64_t hash_bytes(const void* data, size_t len, uint64_t seed);
+int map_file(const char* path, MappedFile* map);
+void unmap_file(MappedFile* map);
+double monotonic_seconds(void);
+uint32_t random_seed(uint32_t seed, uint32_t stream);
+uint32_t random_next(uint32_t* state);
+double random_unit(uint32_t* state);
+uint32_t random_below(uint32_t* state, uint32_t bound);
+
+/* Function declarations - threads.c */
+typedef void (*ParallelTask)(int task, void* ctx);
+int cpu_count(void);
+int parallel_for(int taskCount, int threadCount, ParallelTask fn, void* ctx);
+
+/* A task running on its own thread (threads.c) */
+typedef struct {
+    ParallelTask fn;
+    void* ctx;
+    void* thread;              /* Platform thread, NULL once waited for */
+    volatile long finished;
+} BackgroundTask;
+
+void background_start(BackgroundTask* task, ParallelTask fn, void* ctx);
+int background_finished(BackgroundTask* task);
+void background_wait(BackgroundTask* task);
 
 /* Function declarations - json_utils.c */
 int parse_states_json(AppState* app, const char* jsonStr);
-int parse_geojson(AppState* app, const char* jsonStr);
-char* create_plan_json(AppState* app);
+int parse_geojson_file(AppState* app, const char* path);
+int write_plan_json(AppState* app, FILE* out);
 int parse_plan_json(AppState* app, const char* jsonStr);
 
 /* Function declarations - ui.c */
@@ -1,15 +1,22 @@
 /*
  * US Redistricting Tool - Automap Algorithm
- * 
+ *
  * Generates district maps based on partisan fairness goals while respecting
  * county borders as much as possible.
- * 
+ *
  * Algorithm:
  * 1. Group precincts by county
  * 2. Assign whole counties first when possible
- * 3. Split large counties as needed
- * 4. Optimize swaps to improve fairness metrics
- * 
+ * 3. Grow each district outward across the adjacency graph, splitting
+ *    counties as needed (or, for very large states, replace steps 1-3 with
+ *    the multilevel partitioner)
+ * 4. Optimize swaps to improve fairness metrics, greedily or by simulated
+ *    annealing followed by a greedy pass
+ *
+ * Each run works on its own assignment array and ledger over the shared,
+ * read-only precinct data, so multi-start mode can run several randomized
+ * instances at once and keep the best.
+ *
  * Fairness levels:
  * - Very R: Target 60%+ Republican lean (40% Dem)
  * - Lean R: Target 54% Republican lean (46% Dem)
@@ -29,373 +36,789 @@ FairnessConfig FAIRNESS_PRESETS[5] = {
     { "Very D",  0.60, 0.05, "Strongly Democratic-favoring map" }
 };
 
-/* County group structure */
+/* Nearest assigned precincts used in place of neighbors for islands */
+#define AUTOMAP_NEAREST_K 4
+
+/* Smallest fairness score gain for which phase 3 keeps a move */
+#define PHASE3_MIN_GAIN 0.001
+
+/* Randomized runs: spread of the county size used to order phase 1, and
+   the largest noise added to a frontier score in phase 2 */
+#define RANDOM_COUNTY_SPREAD 0.6
+#define RANDOM_GROW_NOISE 0.05
+
+/* Annealing defaults: proposals per precinct when no budget is given,
+   moves sampled to calibrate the start temperature, and how often the
+   temperature and clock are updated */
+#define ANNEAL_STEPS_PER_PRECINCT 200
+#define ANNEAL_CALIBRATION_SAMPLES 1000
+#define ANNEAL_UPDATE_INTERVAL 1024
+
+/* Random edge draws used to find a boundary flip */
+#define ANNEAL_PROPOSAL_ATTEMPTS 64
+
+/* County group: a bucket of the shared member array */
 typedef struct {
-    char name[MAX_NAME_LEN];
-    int precinctIndices[MAX_PRECINCTS];
+    int countyId;
+    int start;         /* First member in the bucket array */
     int count;
     int totalPop;
     int totalDem;
     int totalRep;
     double demShare;
+    double sortKey;    /* Phase 1 order, largest first */
 } CountyGroup;
 
+/* One automap run over its own assignment. Precinct data, the adjacency
+   graph and the spatial index are only read, so runs can share them. */
+typedef struct {
+    AppState* app;
+    int* district;             /* This run's assignment */
+    DistrictLedger* ledger;    /* Totals for district[] */
+    ContiguityChecker* contiguity;  /* Follows district[] */
+    int numDistricts;
+    int targetPop;
+    double maxDeviation;
+    double targetDemShare;
+    uint32_t rng;              /* 0 for the deterministic run */
+    int verbose;
+    InitialMode initial;
+    OptimizerMode optimizer;
+    AnnealSettings anneal;
+    
+    /* Results */
+    int evaluated;
+    int moves;
+    double startScore;
+    double score;
+} AutomapRun;
+
 /* Get total population */
 static int get_total_population(AppState* app) {
     int total = 0;
     for (int i = 0; i < app->precinctCount; i++) {
-        total += app->precincts[i].population;
+        total += app->population[i];
     }
     return total;
 }
 
 /* Get district statistics */
-static void get_district_stats_quick(AppState* app, int districtId, 
+static void get_district_stats_quick(const DistrictLedger* ledger, int districtId,
                                       int* pop, int* dem, int* rep, double* demShare) {
-    *pop = 0;
-    *dem = 0;
-    *rep = 0;
-    
-    for (int i = 0; i < app->precinctCount; i++) {
-        if (app->precincts[i].district == districtId) {
-            *pop += app->precincts[i].population;
-            *dem += app->precincts[i].dem;
-            *rep += app->precincts[i].rep;
-        }
-    }
+    *pop = ledger->population[districtId];
+    *dem = ledger->dem[districtId];
+    *rep = ledger->rep[districtId];
     
     int total = *dem + *rep;
     *demShare = total > 0 ? (double)*dem / total : 0.5;
 }
 
+/* Move a precinct within this run and keep its ledger and contiguity
+   caches in step */
+static void run_assign(AutomapRun* run, int precinct, int district) {
+    ledger_move(run->ledger, run->app, precinct, run->district[precinct], district);
+    contiguity_moved(run->contiguity, run->district[precinct], district);
+    run->district[precinct] = district;
+}
+
+/* Fairness contribution of one district with the given totals */
+static double district_fairness(int pop, int dem, int rep, int targetPop, double targetDemShare) {
+    if (pop == 0) return 0;
+    
+    /* Population balance component */
+    double popDeviation = fabs((double)(pop - targetPop) / targetPop);
+    double popScore = 1.0 - popDeviation;
+    if (popScore < 0) popScore = 0;
+    
+    /* Partisan target component */
+    int total = dem + rep;
+    double demShare = total > 0 ? (double)dem / total : 0.5;
+    double partisanDeviation = fabs(demShare - targetDemShare);
+    double partisanScore = 1.0 - partisanDeviation * 2;
+    if (partisanScore < 0) partisanScore = 0;
+    
+    return popScore * 0.5 + partisanScore * 0.5;
+}
+
 /* Calculate fairness score for a set of district stats */
-static double calculate_fairness_score(AppState* app, int numDistricts, 
-                                        int targetPop, double targetDemShare) {
+static double calculate_fairness_score(AutomapRun* run) {
     double score = 0;
     
-    for (int d = 1; d <= numDistricts; d++) {
+    for (int d = 1; d <= run->numDistricts; d++) {
         int pop, dem, rep;
         double demShare;
-        get_district_stats_quick(app, d, &pop, &dem, &rep, &demShare);
-        
-        if (pop == 0) continue;
-        
-        /* Population balance component */
-        double popDeviation = fabs((double)(pop - targetPop) / targetPop);
-        double popScore = 1.0 - popDeviation;
-        if (popScore < 0) popScore = 0;
-        
-        /* Partisan target component */
-        double partisanDeviation = fabs(demShare - targetDemShare);
-        double partisanScore = 1.0 - partisanDeviation * 2;
-        if (partisanScore < 0) partisanScore = 0;
-        
-        score += popScore * 0.5 + partisanScore * 0.5;
+        get_district_stats_quick(run->ledger, d, &pop, &dem, &rep, &demShare);
+        score += district_fairness(pop, dem, rep, run->targetPop, run->targetDemShare);
     }
     
-    return score / numDistricts;
+    return score / run->numDistricts;
 }
 
-/* Build county groups */
-static int build_county_groups(AppState* app, CountyGroup* groups, int maxGroups) {
-    int groupCount = 0;
+/* Change in fairness score if a precinct moved from one district to another.
+   Only the two districts involved change, so this reads just their totals. */
+static double move_fairness_delta(AutomapRun* run, int precinct, int from, int to) {
+    const AppState* app = run->app;
+    const DistrictLedger* ledger = run->ledger;
+    int targetPop = run->targetPop;
+    double targetDemShare = run->targetDemShare;
+    int pop = app->population[precinct];
+    int dem = app->dem[precinct];
+    int rep = app->rep[precinct];
+    
+    double before = district_fairness(ledger->population[from], ledger->dem[from], ledger->rep[from],
+                                      targetPop, targetDemShare) +
+                    district_fairness(ledger->population[to], ledger->dem[to], ledger->rep[to],
+                                      targetPop, targetDemShare);
+    double after = district_fairness(ledger->population[from] - pop, ledger->dem[from] - dem,
+                                     ledger->rep[from] - rep, targetPop, targetDemShare) +
+                   district_fairness(ledger->population[to] + pop, ledger->dem[to] + dem,
+                                     ledger->rep[to] + rep, targetPop, targetDemShare);
+    return (after - before) / run->numDistricts;
+}
+
+/* Bucket precincts by county in CSR form: count, prefix-sum, scatter.
+   Group g is county id g, and its precincts are members[start .. start + count). */
+static int build_county_groups(AppState* app, CountyGroup** outGroups, int** outMembers) {
+    int groupCount = app->counties.count;
+    CountyGroup* groups = (CountyGroup*)calloc(groupCount > 0 ? groupCount : 1, sizeof(CountyGroup));
+    int* members = (int*)malloc(sizeof(int) * (app->precinctCount > 0 ? app->precinctCount : 1));
+    if (!groups || !members) {
+        free(groups);
+        free(members);
+        return -1;
+    }
     
     for (int i = 0; i < app->precinctCount; i++) {
-        Precinct* p = &app->precincts[i];
-        
-        /* Find existing county group */
-        int found = -1;
-        for (int g = 0; g < groupCount; g++) {
-            if (strcmp(groups[g].name, p->county) == 0) {
-                found = g;
-                break;
-            }
-        }
-        
-        if (found < 0) {
-            if (groupCount >= maxGroups) continue;
-            found = groupCount++;
-            memset(&groups[found], 0, sizeof(CountyGroup));
-            strncpy(groups[found].name, p->county, MAX_NAME_LEN - 1);
-        }
-        
-        groups[found].precinctIndices[groups[found].count++] = i;
-        groups[found].totalPop += p->population;
-        groups[found].totalDem += p->dem;
-        groups[found].totalRep += p->rep;
+        CountyGroup* group = &groups[app->countyId[i]];
+        group->count++;
+        group->totalPop += app->population[i];
+        group->totalDem += app->dem[i];
+        group->totalRep += app->rep[i];
     }
     
-    /* Calculate dem share for each county */
+    int offset = 0;
     for (int g = 0; g < groupCount; g++) {
+        groups[g].countyId = g;
+        groups[g].start = offset;
+        offset += groups[g].count;
+        groups[g].count = 0;
+        
+        /* Calculate dem share for each county */
         int total = groups[g].totalDem + groups[g].totalRep;
         groups[g].demShare = total > 0 ? (double)groups[g].totalDem / total : 0.5;
     }
     
+    for (int i = 0; i < app->precinctCount; i++) {
+        CountyGroup* group = &groups[app->countyId[i]];
+        members[group->start + group->count++] = i;
+    }
+    
+    *outGroups = groups;
+    *outMembers = members;
     return groupCount;
 }
 
-/* Compare counties by size for sorting */
-static int compare_counties_by_size(const void* a, const void* b) {
-    const CountyGroup* ca = (const CountyGroup*)a;
-    const CountyGroup* cb = (const CountyGroup*)b;
-    return cb->totalPop - ca->totalPop; /* Descending order */
+/* Spatial filter: precincts that already have a district in this run */
+static int is_assigned_precinct(int precinct, void* ctx) {
+    AutomapRun* run = (AutomapRun*)ctx;
+    return run->district[precinct] > 0;
 }
 
-/* Generate districts using automap algorithm */
-int generate_automap(AppState* app, int numDistricts, FairnessPreset preset, double customTarget) {
-    if (!app->currentState || app->precinctCount == 0) {
-        fprintf(stderr, "No state or precinct data loaded.\n");
-        return 0;
+/* Frontier entry for region growing: assign precinct to district */
+typedef struct {
+    double score;
+    int precinct;
+    int district;
+    int version;       /* District version the score was computed against */
+} GrowEntry;
+
+/* Max-heap of frontier entries */
+typedef struct {
+    GrowEntry* items;
+    int count;
+    int capacity;
+} GrowQueue;
+
+static int grow_push(GrowQueue* q, GrowEntry e) {
+    if (q->count >= q->capacity) {
+        int newCap = q->capacity ? q->capacity * 2 : 1024;
+        GrowEntry* grown = (GrowEntry*)realloc(q->items, sizeof(GrowEntry) * newCap);
+        if (!grown) return 0;
+        q->items = grown;
+        q->capacity = newCap;
     }
     
-    printf("\n=== Automap District Generation ===\n");
+    int i = q->count++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (q->items[parent].score >= e.score) break;
+        q->items[i] = q->items[parent];
+        i = parent;
+    }
+    q->items[i] = e;
+    return 1;
+}
+
+static GrowEntry grow_pop(GrowQueue* q) {
+    GrowEntry top = q->items[0];
+    GrowEntry last = q->items[--q->count];
+    
+    int i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= q->count) break;
+        if (child + 1 < q->count && q->items[child + 1].score > q->items[child].score) child++;
+        if (last.score >= q->items[child].score) break;
+        q->items[i] = q->items[child];
+        i = child;
+    }
+    if (q->count > 0) q->items[i] = last;
+    return top;
+}
+
+/* Score for adding a precinct to a district it borders */
+static double grow_score(AutomapRun* run, int precinct, int d) {
+    const AppState* app = run->app;
+    const DistrictLedger* ledger = run->ledger;
+    int targetPop = run->targetPop;
     
-    /* Get target parameters */
-    double targetDemShare = customTarget > 0 ? customTarget : FAIRNESS_PRESETS[preset].targetDemShare;
-    /* tolerance could be used for future refinements */
-    (void)FAIRNESS_PRESETS[preset].tolerance;
+    int newPop = ledger->population[d] + app->population[precinct];
+    double popScore = 1.0 - fabs((double)(newPop - targetPop) / targetPop);
     
-    printf("Fairness preset: %s\n", FAIRNESS_PRESETS[preset].label);
-    printf("Target Dem share: %.1f%%\n", targetDemShare * 100);
-    printf("Number of districts: %d\n", numDistricts);
+    int newDem = ledger->dem[d] + app->dem[precinct];
+    int newRep = ledger->rep[d] + app->rep[precinct];
+    double newDemShare = (newDem + newRep) > 0 ? (double)newDem / (newDem + newRep) : 0.5;
+    double partisanScore = 1.0 - fabs(newDemShare - run->targetDemShare);
     
-    int totalPop = get_total_population(app);
-    int targetPop = totalPop / numDistricts;
-    double maxDeviation = 0.10; /* Allow 10% population deviation */
+    /* Bonus for same county */
+    double countyBonus = ledger->countyMembers[d * ledger->countyTotal + app->countyId[precinct]] > 0 ? 0.2 : 0;
     
-    printf("Total population: %d\n", totalPop);
-    printf("Target population per district: %d (±%.0f%%)\n", targetPop, maxDeviation * 100);
+    /* Frontier precincts always border the district */
+    double adjacencyBonus = 0.1;
+    
+    double score = popScore * 0.4 + partisanScore * 0.3 + countyBonus + adjacencyBonus;
+    if (run->rng) {
+        score += random_unit(&run->rng) * RANDOM_GROW_NOISE;
+    }
+    return score;
+}
+
+/* Queue every unassigned neighbor of a precinct on its district's frontier */
+static int grow_frontier(AutomapRun* run, GrowQueue* queues, const int* version, int precinct) {
+    const AdjacencyGraph* g = &run->app->adjacency;
+    int d = run->district[precinct];
+    
+    for (int k = g->offsets[precinct]; k < g->offsets[precinct + 1]; k++) {
+        int n = g->neighbors[k];
+        if (run->district[n] != 0) continue;
+        GrowEntry e = { grow_score(run, n, d), n, d, version[d] };
+        if (!grow_push(&queues[d], e)) return 0;
+    }
+    return 1;
+}
+
+/* Pick a seed for an empty district: the unassigned precinct farthest from
+   every district seeded so far. The first seed is the westernmost precinct,
+   or a random one in a randomized run. */
+static int pick_seed(AutomapRun* run, const double* seedX, const double* seedY, int seedCount) {
+    AppState* app = run->app;
+    int best = -1;
+    double bestDist = -1;
+    
+    if (seedCount == 0 && run->rng) {
+        int unassigned = run->ledger->precinctCount[0];
+        if (unassigned == 0) return -1;
+        int pick = (int)(random_next(&run->rng) % (uint32_t)unassigned);
+        for (int i = 0; i < app->precinctCount; i++) {
+            if (run->district[i] == 0 && pick-- == 0) return i;
+        }
+        return -1;
+    }
     
-    /* Reset all assignments */
     for (int i = 0; i < app->precinctCount; i++) {
-        app->precincts[i].district = 0;
+        if (run->district[i] != 0) continue;
+        double x = app->precincts[i].centroid.x;
+        double y = app->precincts[i].centroid.y;
+        
+        double nearest;
+        if (seedCount == 0) {
+            nearest = -x;
+        } else {
+            nearest = 1e300;
+            for (int s = 0; s < seedCount; s++) {
+                double dx = x - seedX[s], dy = y - seedY[s];
+                double dist = dx * dx + dy * dy;
+                if (dist < nearest) nearest = dist;
+            }
+        }
+        if (best < 0 || nearest > bestDist) {
+            best = i;
+            bestDist = nearest;
+        }
+    }
+    return best;
+}
+
+/* Grow every district outward from its assigned precincts. Each district
+   keeps its own frontier queue; the least populated district that can still
+   grow takes its best-scoring frontier precinct next, which keeps districts
+   from being boxed in by faster neighbors. District totals come from the
+   ledger; an assignment bumps the district's version, and a stale entry is
+   rescored when it reaches the top instead of being searched for and
+   updated. Growth only crosses graph edges, so districts stay contiguous. */
+static int grow_districts(AutomapRun* run) {
+    AppState* app = run->app;
+    const DistrictLedger* ledger = run->ledger;
+    int numDistricts = run->numDistricts;
+    int version[MAX_DISTRICTS + 1] = {0};
+    GrowQueue queues[MAX_DISTRICTS + 1];
+    memset(queues, 0, sizeof(queues));
+    int ok = 1;
+    
+    /* Seed districts phase 1 left empty, spread out across the state */
+    double seedX[MAX_DISTRICTS], seedY[MAX_DISTRICTS];
+    int seedCount = 0;
+    for (int d = 1; d <= numDistricts; d++) {
+        if (ledger->precinctCount[d] == 0) continue;
+        double sx = 0, sy = 0;
+        for (int i = 0; i < app->precinctCount; i++) {
+            if (run->district[i] == d) {
+                sx += app->precincts[i].centroid.x;
+                sy += app->precincts[i].centroid.y;
+            }
+        }
+        seedX[seedCount] = sx / ledger->precinctCount[d];
+        seedY[seedCount] = sy / ledger->precinctCount[d];
+        seedCount++;
+    }
+    for (int d = 1; d <= numDistricts; d++) {
+        if (ledger->precinctCount[d] > 0) continue;
+        int seed = pick_seed(run, seedX, seedY, seedCount);
+        if (seed < 0) break;
+        run_assign(run, seed, d);
+        seedX[seedCount] = app->precincts[seed].centroid.x;
+        seedY[seedCount] = app->precincts[seed].centroid.y;
+        seedCount++;
     }
     
-    /* Build county groups */
-    CountyGroup* counties = (CountyGroup*)malloc(sizeof(CountyGroup) * 500);
-    if (!counties) {
-        fprintf(stderr, "Memory allocation failed.\n");
+    /* Pass 0 keeps districts under the population cap; pass 1 lets the
+       remaining frontier spill into any bordering district. */
+    for (int pass = 0; pass < 2 && ok; pass++) {
+        for (int d = 1; d <= numDistricts; d++) {
+            queues[d].count = 0;
+        }
+        for (int i = 0; i < app->precinctCount && ok; i++) {
+            if (run->district[i] != 0) {
+                ok = grow_frontier(run, queues, version, i);
+            }
+        }
+        
+        while (ok) {
+            int d = 0;
+            for (int c = 1; c <= numDistricts; c++) {
+                if (queues[c].count == 0) continue;
+                if (pass == 0 && ledger->population[c] >= run->targetPop * (1 + run->maxDeviation)) continue;
+                if (d == 0 || ledger->population[c] < ledger->population[d]) d = c;
+            }
+            if (d == 0) break;
+            
+            GrowEntry e = grow_pop(&queues[d]);
+            if (run->district[e.precinct] != 0) continue;
+            
+            if (e.version != version[d]) {
+                /* District grew since this was scored */
+                e.score = grow_score(run, e.precinct, d);
+                e.version = version[d];
+                ok = grow_push(&queues[d], e);
+                continue;
+            }
+            
+            run_assign(run, e.precinct, d);
+            version[d]++;
+            ok = grow_frontier(run, queues, version, e.precinct);
+        }
+    }
+    
+    /* Anything left is cut off from every district (islands, point-only
+       data): join the least populated of the nearest assigned precincts'
+       districts, then flood the rest of its component into that district. */
+    for (int i = 0; i < app->precinctCount && ok; i++) {
+        if (run->district[i] != 0) continue;
+        
+        int nearest[AUTOMAP_NEAREST_K];
+        double nearestDist[AUTOMAP_NEAREST_K];
+        int found = spatial_k_nearest(&app->spatial, app, app->precincts[i].centroid.x,
+                                      app->precincts[i].centroid.y, AUTOMAP_NEAREST_K,
+                                      is_assigned_precinct, run, nearest, nearestDist);
+        int target = 1;
+        for (int n = 0; n < found; n++) {
+            int d = run->district[nearest[n]];
+            if (n == 0 || ledger->population[d] < ledger->population[target]) target = d;
+        }
+        run_assign(run, i, target);
+        
+        GrowQueue* q = &queues[target];
+        q->count = 0;
+        ok = grow_frontier(run, queues, version, i);
+        while (ok && q->count > 0) {
+            GrowEntry e = grow_pop(q);
+            if (run->district[e.precinct] != 0) continue;
+            run_assign(run, e.precinct, target);
+            ok = grow_frontier(run, queues, version, e.precinct);
+        }
+    }
+    
+    for (int d = 0; d <= MAX_DISTRICTS; d++) {
+        free(queues[d].items);
+    }
+    return ok;
+}
+
+/* Compare counties by phase 1 order for sorting */
+static int compare_counties_by_size(const void* a, const void* b) {
+    const CountyGroup* ca = (const CountyGroup*)a;
+    const CountyGroup* cb = (const CountyGroup*)b;
+    /* Descending order */
+    if (ca->sortKey != cb->sortKey) return ca->sortKey < cb->sortKey ? 1 : -1;
+    return ca->countyId - cb->countyId;
+}
+
+/* Phase 1: fill districts in turn with whole counties, largest first. A
+   randomized run jitters the county sizes used for the order. */
+static int assign_whole_counties(AutomapRun* run) {
+    AppState* app = run->app;
+    const DistrictLedger* ledger = run->ledger;
+    int targetPop = run->targetPop;
+    double maxDeviation = run->maxDeviation;
+    
+    CountyGroup* counties = NULL;
+    int* countyMembers = NULL;
+    int countyCount = build_county_groups(app, &counties, &countyMembers);
+    if (countyCount < 0) {
         return 0;
     }
+    if (run->verbose) {
+        printf("Counties found: %d\n", countyCount);
+    }
     
-    int countyCount = build_county_groups(app, counties, 500);
-    printf("Counties found: %d\n", countyCount);
+    for (int g = 0; g < countyCount; g++) {
+        counties[g].sortKey = counties[g].totalPop;
+        if (run->rng) {
+            counties[g].sortKey *= 1.0 + RANDOM_COUNTY_SPREAD * (random_unit(&run->rng) - 0.5);
+        }
+    }
     
     /* Sort counties by size (largest first) */
     qsort(counties, countyCount, sizeof(CountyGroup), compare_counties_by_size);
     
-    /* First pass: Assign whole counties */
-    printf("\nPhase 1: Assigning whole counties...\n");
-    
     int currentDistrict = 1;
-    int districtPop[MAX_DISTRICTS] = {0};
-    int districtDem[MAX_DISTRICTS] = {0};
-    int districtRep[MAX_DISTRICTS] = {0};
-    int assignedCounties[500] = {0};
     
-    for (int g = 0; g < countyCount && currentDistrict <= numDistricts; g++) {
+    for (int g = 0; g < countyCount && currentDistrict <= run->numDistricts; g++) {
         CountyGroup* county = &counties[g];
         
         /* Check if adding this county would exceed population limit */
-        if (districtPop[currentDistrict - 1] + county->totalPop <= targetPop * (1 + maxDeviation)) {
+        if (ledger->population[currentDistrict] + county->totalPop <= targetPop * (1 + maxDeviation)) {
             /* Assign all precincts in county to current district */
             for (int p = 0; p < county->count; p++) {
-                int precinctIdx = county->precinctIndices[p];
-                app->precincts[precinctIdx].district = currentDistrict;
+                int precinctIdx = countyMembers[county->start + p];
+                run_assign(run, precinctIdx, currentDistrict);
             }
             
-            districtPop[currentDistrict - 1] += county->totalPop;
-            districtDem[currentDistrict - 1] += county->totalDem;
-            districtRep[currentDistrict - 1] += county->totalRep;
-            assignedCounties[g] = 1;
-            
             /* Check if district is full enough */
-            if (districtPop[currentDistrict - 1] >= targetPop * (1 - maxDeviation)) {
+            if (ledger->population[currentDistrict] >= targetPop * (1 - maxDeviation)) {
                 currentDistrict++;
             }
         }
     }
     
-    int phase1Assigned = 0;
-    for (int i = 0; i < app->precinctCount; i++) {
-        if (app->precincts[i].district > 0) phase1Assigned++;
+    free(counties);
+    free(countyMembers);
+    return 1;
+}
+
+/* Phase 3: work through (border precinct, adjacent district) candidates; a
+   kept move re-queues the precinct and its neighbors. Each kept move raises
+   the score by more than PHASE3_MIN_GAIN and the score is bounded, so the
+   worklist always drains. */
+static int optimize_borders(AutomapRun* run) {
+    AppState* app = run->app;
+    BorderSet border;
+    int ok = 1;
+    
+    if (border_init(&border, app, run->district)) {
+        BorderCandidate c;
+        while (border_next(&border, &c)) {
+            int i = c.precinct;
+            int oldDistrict = run->district[i];
+            if (run->ledger->precinctCount[oldDistrict] <= 1) continue;
+            run->evaluated++;
+            
+            /* Score the move from the two districts' totals */
+            double gain = move_fairness_delta(run, i, oldDistrict, c.district);
+            
+            if (gain > PHASE3_MIN_GAIN && contiguity_removal_ok(run->contiguity, run->district, i)) {
+                run_assign(run, i, c.district);
+                run->moves++;
+                if (!border_moved(&border, app, run->district, i)) {
+                    ok = 0;
+                    break;
+                }
+            }
+        }
+        border_free(&border);
+    } else {
+        ok = 0;
     }
-    printf("Phase 1 complete: %d/%d precincts assigned\n", phase1Assigned, app->precinctCount);
-    
-    /* Second pass: Assign remaining precincts strategically */
-    printf("\nPhase 2: Assigning remaining precincts...\n");
-    
-    /* Sort unassigned precincts by dem share based on target */
-    int* unassigned = (int*)malloc(sizeof(int) * app->precinctCount);
-    int unassignedCount = 0;
-    
-    for (int i = 0; i < app->precinctCount; i++) {
-        if (app->precincts[i].district == 0) {
-            unassigned[unassignedCount++] = i;
+    return ok;
+}
+
+/* Propose a boundary flip: draw random graph edges until one joins two
+   districts, and move its first precinct into the other's district */
+static int propose_flip(AutomapRun* run, uint32_t* rng, int* precinct, int* to) {
+    const AdjacencyGraph* g = &run->app->adjacency;
+    int n = run->app->precinctCount;
+    
+    for (int attempt = 0; attempt < ANNEAL_PROPOSAL_ATTEMPTS; attempt++) {
+        int p = (int)random_below(rng, (uint32_t)n);
+        int degree = g->offsets[p + 1] - g->offsets[p];
+        if (degree == 0) continue;
+        int q = g->neighbors[g->offsets[p] + (int)random_below(rng, (uint32_t)degree)];
+        if (run->district[p] != run->district[q] && run->district[q] > 0) {
+            *precinct = p;
+            *to = run->district[q];
+            return 1;
         }
     }
-    
-    /* Simple bubble sort by dem share */
-    for (int i = 0; i < unassignedCount - 1; i++) {
-        for (int j = 0; j < unassignedCount - i - 1; j++) {
-            int swap = 0;
-            if (targetDemShare > 0.5) {
-                /* Sort descending for Dem-favoring */
-                swap = app->precincts[unassigned[j]].demShare < 
-                       app->precincts[unassigned[j + 1]].demShare;
-            } else if (targetDemShare < 0.5) {
-                /* Sort ascending for Rep-favoring */
-                swap = app->precincts[unassigned[j]].demShare > 
-                       app->precincts[unassigned[j + 1]].demShare;
-            }
-            if (swap) {
-                int temp = unassigned[j];
-                unassigned[j] = unassigned[j + 1];
-                unassigned[j + 1] = temp;
-            }
+    return 0;
+}
+
+/* Start temperature at which a typical worsening flip is accepted half the time */
+static double calibrate_temperature(AutomapRun* run, uint32_t* rng) {
+    double total = 0;
+    int count = 0;
+    
+    for (int k = 0; k < ANNEAL_CALIBRATION_SAMPLES; k++) {
+        int p, to;
+        if (!propose_flip(run, rng, &p, &to)) continue;
+        double delta = move_fairness_delta(run, p, run->district[p], to);
+        if (delta < 0) {
+            total -= delta;
+            count++;
         }
     }
-    
-    /* Assign each unassigned precinct to the best district */
-    for (int u = 0; u < unassignedCount; u++) {
-        int precinctIdx = unassigned[u];
-        Precinct* p = &app->precincts[precinctIdx];
+    return count > 0 ? total / count / log(2.0) : 1e-6;
+}
+
+/* Phase 3, annealing mode: single-precinct boundary flips scored by their
+   O(1) fairness delta. Improving flips are always taken and worsening ones
+   with probability exp(delta / T); either way the flip must keep the source
+   district contiguous. The temperature falls geometrically from start to
+   end over the step or time budget, whichever runs out first. */
+static void anneal_borders(AutomapRun* run) {
+    AppState* app = run->app;
+    const AnnealSettings* settings = &run->anneal;
+    
+    uint32_t rng = random_seed(settings->seed, run->rng);
+    long steps = settings->steps > 0 ? settings->steps : (long)ANNEAL_STEPS_PER_PRECINCT * app->precinctCount;
+    double startTemp = settings->startTemp > 0 ? settings->startTemp : calibrate_temperature(run, &rng);
+    double endTemp = settings->endTemp > 0 ? settings->endTemp : startTemp / 100;
+    
+    /* Acceptance counts per quarter of the schedule */
+    long proposed[4] = {0}, accepted[4] = {0};
+    double quarterTemp[4] = {0};
+    long improving = 0, worsening = 0, blocked = 0, noFlip = 0;
+    
+    double started = monotonic_seconds();
+    double progress = 0;
+    double temp = startTemp;
+    long step;
+    for (step = 0; step < steps; step++) {
+        if (step % ANNEAL_UPDATE_INTERVAL == 0) {
+            progress = (double)step / steps;
+            if (settings->seconds > 0) {
+                double elapsed = monotonic_seconds() - started;
+                if (elapsed >= settings->seconds) break;
+                if (elapsed / settings->seconds > progress) progress = elapsed / settings->seconds;
+            }
+            temp = startTemp * pow(endTemp / startTemp, progress);
+        }
+        int quarter = progress < 1 ? (int)(progress * 4) : 3;
+        if (quarterTemp[quarter] == 0) quarterTemp[quarter] = temp;
         
-        int bestDistrict = -1;
-        double bestScore = -1e9;
+        int p, to;
+        if (!propose_flip(run, &rng, &p, &to)) {
+            noFlip++;
+            continue;
+        }
+        int from = run->district[p];
+        if (run->ledger->precinctCount[from] <= 1) continue;
+        proposed[quarter]++;
         
-        for (int d = 1; d <= numDistricts; d++) {
-            /* Recalculate current district stats */
-            int dPop = 0, dDem = 0, dRep = 0;
-            for (int i = 0; i < app->precinctCount; i++) {
-                if (app->precincts[i].district == d) {
-                    dPop += app->precincts[i].population;
-                    dDem += app->precincts[i].dem;
-                    dRep += app->precincts[i].rep;
-                }
-            }
-            
-            /* Skip if district is already too full */
-            if (dPop >= targetPop * (1 + maxDeviation)) continue;
-            
-            /* Calculate score for adding this precinct */
-            int newPop = dPop + p->population;
-            double popScore = 1.0 - fabs((double)(newPop - targetPop) / targetPop);
-            
-            int newDem = dDem + p->dem;
-            int newRep = dRep + p->rep;
-            double newDemShare = (newDem + newRep) > 0 ? (double)newDem / (newDem + newRep) : 0.5;
-            double partisanScore = 1.0 - fabs(newDemShare - targetDemShare);
-            
-            /* Bonus for same county */
-            double countyBonus = 0;
-            for (int i = 0; i < app->precinctCount; i++) {
-                if (app->precincts[i].district == d && 
-                    strcmp(app->precincts[i].county, p->county) == 0) {
-                    countyBonus = 0.2;
-                    break;
-                }
-            }
-            
-            /* Bonus for adjacency */
-            double adjacencyBonus = 0;
-            for (int n = 0; n < p->neighborCount; n++) {
-                if (app->precincts[p->neighbors[n]].district == d) {
-                    adjacencyBonus = 0.1;
-                    break;
-                }
-            }
-            
-            double score = popScore * 0.4 + partisanScore * 0.3 + countyBonus + adjacencyBonus;
-            
-            if (score > bestScore) {
-                bestScore = score;
-                bestDistrict = d;
-            }
+        double delta = move_fairness_delta(run, p, from, to);
+        if (delta < 0 && random_unit(&rng) >= exp(delta / temp)) continue;
+        if (!contiguity_removal_ok(run->contiguity, run->district, p)) {
+            blocked++;
+            continue;
         }
         
-        if (bestDistrict > 0) {
-            p->district = bestDistrict;
-        } else {
-            /* Fallback: assign to least populated district */
-            int minPop = 999999999;
-            int minDistrict = 1;
-            for (int d = 1; d <= numDistricts; d++) {
-                int dPop = 0;
-                for (int i = 0; i < app->precinctCount; i++) {
-                    if (app->precincts[i].district == d) {
-                        dPop += app->precincts[i].population;
-                    }
-                }
-                if (dPop < minPop) {
-                    minPop = dPop;
-                    minDistrict = d;
-                }
-            }
-            p->district = minDistrict;
+        run_assign(run, p, to);
+        accepted[quarter]++;
+        if (delta < 0) worsening++;
+        else improving++;
+    }
+    double elapsed = monotonic_seconds() - started;
+    
+    long totalProposed = proposed[0] + proposed[1] + proposed[2] + proposed[3];
+    long totalAccepted = accepted[0] + accepted[1] + accepted[2] + accepted[3];
+    run->evaluated += totalProposed;
+    run->moves += totalAccepted;
+    
+    if (run->verbose) {
+        printf("Annealing: %ld steps in %.2f s, temperature %.3g -> %.3g\n",
+               step, elapsed, startTemp, endTemp);
+        printf("  %ld flips proposed, %ld accepted (%.1f%%): %ld improving, %ld worsening\n",
+               totalProposed, totalAccepted,
+               totalProposed > 0 ? 100.0 * totalAccepted / totalProposed : 0.0,
+               improving, worsening);
+        printf("  %ld rejected to keep districts contiguous", blocked);
+        if (noFlip > 0) printf(", %ld steps found no boundary edge", noFlip);
+        printf("\n");
+        for (int q = 0; q < 4; q++) {
+            if (proposed[q] == 0) continue;
+            printf("  Schedule %d/4: T %.3g, acceptance %.1f%%\n", q + 1, quarterTemp[q],
+                   100.0 * accepted[q] / proposed[q]);
         }
     }
+}
+
+/* Phases 1-2 by multilevel partitioning, which fills district[] directly */
+static int partition_multilevel(AutomapRun* run) {
+    AppState* app = run->app;
+    if (run->verbose) printf("\nPhases 1-2: Multilevel partitioning...\n");
+    if (!multilevel_partition(app, run->numDistricts, run->district, run->rng, run->verbose)) {
+        fprintf(stderr, "Multilevel partitioning failed.\n");
+        return 0;
+    }
+    if (!ledger_rebuild(run->ledger, app, run->district) || !contiguity_init(run->contiguity, app)) {
+        return 0;
+    }
+    if (run->verbose) {
+        printf("Phase 2 complete: %d/%d precincts assigned\n",
+               app->precinctCount - run->ledger->precinctCount[0], app->precinctCount);
+    }
+    return 1;
+}
+
+/* Phases 1-2 by whole counties and region growing */
+static int partition_counties(AutomapRun* run) {
+    const DistrictLedger* ledger = run->ledger;
+    int precinctCount = run->app->precinctCount;
     
-    free(unassigned);
+    /* First pass: Assign whole counties */
+    if (run->verbose) printf("\nPhase 1: Assigning whole counties...\n");
+    if (!assign_whole_counties(run)) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        return 0;
+    }
+    if (run->verbose) {
+        printf("Phase 1 complete: %d/%d precincts assigned\n",
+               precinctCount - ledger->precinctCount[0], precinctCount);
+    }
     
-    int phase2Assigned = 0;
-    for (int i = 0; i < app->precinctCount; i++) {
-        if (app->precincts[i].district > 0) phase2Assigned++;
+    /* Second pass: Assign remaining precincts strategically */
+    if (run->verbose) printf("\nPhase 2: Assigning remaining precincts...\n");
+    if (!grow_districts(run)) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        return 0;
+    }
+    if (run->verbose) {
+        printf("Phase 2 complete: %d/%d precincts assigned\n",
+               precinctCount - ledger->precinctCount[0], precinctCount);
+    }
+    return 1;
+}
+
+/* Run all three phases on an unassigned run */
+static int automap_run(AutomapRun* run) {
+    int ok = run->initial == INITIAL_MULTILEVEL ? partition_multilevel(run) : partition_counties(run);
+    if (!ok) {
+        return 0;
     }
-    printf("Phase 2 complete: %d/%d precincts assigned\n", phase2Assigned, app->precinctCount);
     
     /* Third pass: Optimization - swap border precincts to improve fairness */
-    printf("\nPhase 3: Optimizing district assignments...\n");
+    if (run->verbose) {
+        printf("\nPhase 3: Optimizing district assignments%s...\n",
+               run->optimizer == OPTIMIZER_ANNEAL ? " (simulated annealing)" : "");
+    }
+    run->startScore = calculate_fairness_score(run);
+    if (run->optimizer == OPTIMIZER_ANNEAL) {
+        anneal_borders(run);
+    }
+    if (!optimize_borders(run)) {
+        fprintf(stderr, "Out of memory; optimization stopped early.\n");
+    }
+    run->score = calculate_fairness_score(run);
+    if (run->verbose) {
+        printf("Phase 3 complete: %d candidate moves evaluated, %d kept, score %.4f -> %.4f\n",
+               run->evaluated, run->moves, run->startScore, run->score);
+        const ContiguityChecker* c = run->contiguity;
+        printf("Contiguity checks: %ld local, %ld cached, %ld searched, %ld articulation scans\n",
+               c->localHits, c->cacheHits, c->searchHits, c->articulationRuns);
+    }
+    return 1;
+}
+
+/* Fill in the shared run parameters and print them */
+static void setup_run(AutomapRun* run, AppState* app, int numDistricts, FairnessPreset preset,
+                      double customTarget) {
+    memset(run, 0, sizeof(AutomapRun));
+    run->app = app;
+    run->numDistricts = numDistricts;
     
-    int maxIterations = 50;
-    int iteration = 0;
-    int improved = 1;
+    /* Get target parameters */
+    run->targetDemShare = customTarget > 0 ? customTarget : FAIRNESS_PRESETS[preset].targetDemShare;
+    /* tolerance could be used for future refinements */
+    (void)FAIRNESS_PRESETS[preset].tolerance;
     
-    while (improved && iteration < maxIterations) {
-        improved = 0;
-        iteration++;
-        
-        /* Find border precincts */
-        for (int i = 0; i < app->precinctCount; i++) {
-            Precinct* p = &app->precincts[i];
-            if (p->district == 0) continue;
-            
-            /* Check if this is a border precinct */
-            int isBorder = 0;
-            int neighborDistrict = 0;
-            
-            for (int n = 0; n < p->neighborCount; n++) {
-                int ni = p->neighbors[n];
-                if (app->precincts[ni].district != 0 && 
-                    app->precincts[ni].district != p->district) {
-                    isBorder = 1;
-                    neighborDistrict = app->precincts[ni].district;
-                    break;
-                }
-            }
-            
-            if (!isBorder || neighborDistrict == 0) continue;
-            
-            /* Calculate current fairness score */
-            double currentScore = calculate_fairness_score(app, numDistricts, targetPop, targetDemShare);
-            
-            /* Try swapping to neighbor district */
-            int oldDistrict = p->district;
-            p->district = neighborDistrict;
-            
-            double newScore = calculate_fairness_score(app, numDistricts, targetPop, targetDemShare);
-            
-            if (newScore > currentScore + 0.001) {
-                improved = 1;
-                /* Keep the swap */
-            } else {
-                /* Revert */
-                p->district = oldDistrict;
-            }
-        }
+    printf("Fairness preset: %s\n", FAIRNESS_PRESETS[preset].label);
+    printf("Target Dem share: %.1f%%\n", run->targetDemShare * 100);
+    printf("Number of districts: %d\n", numDistricts);
+    
+    int totalPop = get_total_population(app);
+    run->targetPop = totalPop / numDistricts;
+    run->maxDeviation = 0.10; /* Allow 10% population deviation */
+    run->initial = app->initialMode;
+    run->optimizer = app->optimizer;
+    run->anneal = app->anneal;
+    
+    printf("Total population: %d\n", totalPop);
+    printf("Target population per district: %d (±%.0f%%)\n", run->targetPop, run->maxDeviation * 100);
+}
+
+/* Generate districts using automap algorithm */
+int generate_automap(AppState* app, int numDistricts, FairnessPreset preset, double customTarget) {
+    if (!app->currentState || app->precinctCount == 0) {
+        fprintf(stderr, "No state or precinct data loaded.\n");
+        return 0;
+    }
+    
+    printf("\n=== Automap District Generation ===\n");
+    
+    AutomapRun run;
+    setup_run(&run, app, numDistricts, preset, customTarget);
+    run.district = app->district;
+    run.ledger = &app->ledger;
+    run.contiguity = &app->contiguity;
+    run.verbose = 1;
+    
+    /* Reset all assignments */
+    if (!clear_assignments(app)) {
+        return 0;
     }
     
-    printf("Phase 3 complete: %d optimization iterations\n", iteration);
+    if (!automap_run(&run)) {
+        return 0;
+    }
     
     /* Update plan */
     app->currentPlan.numDistricts = numDistricts;
@@ -403,11 +826,127 @@ int generate_automap(AppState* app, int numDistricts, FairnessPreset preset, dou
     
     /* Generate summary */
     print_automap_summary(app);
-    
-    free(counties);
     return 1;
 }
 
+/* Shared state for a multi-start batch */
+typedef struct {
+    AutomapRun base;           /* Parameters copied into every run */
+    uint32_t seed;
+    int** assignments;         /* Per-run result, NULL if the run failed */
+    double* scores;
+} MultiStart;
+
+/* One multi-start task: a private assignment, ledger and contiguity
+   checker over shared data */
+static void multistart_task(int task, void* ctx) {
+    MultiStart* ms = (MultiStart*)ctx;
+    AppState* app = ms->base.app;
+    
+    AutomapRun run = ms->base;
+    DistrictLedger ledger;
+    ContiguityChecker contiguity;
+    memset(&ledger, 0, sizeof(ledger));
+    memset(&contiguity, 0, sizeof(contiguity));
+    run.district = (int*)calloc(app->precinctCount, sizeof(int));
+    run.ledger = &ledger;
+    run.contiguity = &contiguity;
+    /* Start 0 is the deterministic run, so best-of-K never does worse */
+    run.rng = task == 0 ? 0 : random_seed(ms->seed, (uint32_t)task);
+    
+    if (run.district && ledger_rebuild(&ledger, app, run.district) &&
+        contiguity_init(&contiguity, app) && automap_run(&run)) {
+        ms->assignments[task] = run.district;
+        ms->scores[task] = run.score;
+    } else {
+        free(run.district);
+    }
+    ledger_free(&ledger);
+    contiguity_free(&contiguity);
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/* Run several randomized automap instances in parallel and keep the best */
+int generate_automap_multistart(AppState* app, int numDistricts, FairnessPreset preset,
+                                double customTarget, int starts, uint32_t seed) {
+    if (!app->currentState || app->precinctCount == 0) {
+        fprintf(stderr, "No state or precinct data loaded.\n");
+        return 0;
+    }
+    if (starts < 1) starts = 1;
+    
+    printf("\n=== Automap Multi-Start (%d runs) ===\n", starts);
+    
+    MultiStart ms;
+    setup_run(&ms.base, app, numDistricts, preset, customTarget);
+    ms.seed = seed;
+    ms.assignments = (int**)calloc(starts, sizeof(int*));
+    ms.scores = (double*)calloc(starts, sizeof(double));
+    if (!ms.assignments || !ms.scores) {
+        free(ms.assignments);
+        free(ms.scores);
+        fprintf(stderr, "Memory allocation failed.\n");
+        return 0;
+    }
+    
+    int threads = cpu_count();
+    double started = monotonic_seconds();
+    threads = parallel_for(starts, threads, multistart_task, &ms);
+    double elapsed = monotonic_seconds() - started;
+    
+    /* Pick the best run and collect the score distribution */
+    int best = -1;
+    int completed = 0;
+    double* sorted = (double*)malloc(sizeof(double) * starts);
+    for (int k = 0; k < starts; k++) {
+        if (!ms.assignments[k]) continue;
+        if (sorted) sorted[completed] = ms.scores[k];
+        completed++;
+        if (best < 0 || ms.scores[k] > ms.scores[best]) best = k;
+    }
+    
+    int ok = best >= 0;
+    if (ok) {
+        memcpy(app->district, ms.assignments[best], sizeof(int) * app->precinctCount);
+        ok = sync_ledger(app);
+    } else {
+        fprintf(stderr, "Every automap run failed.\n");
+    }
+    
+    if (ok) {
+        printf("\nCompleted %d/%d runs on %d threads in %.2f s\n", completed, starts, threads, elapsed);
+        if (sorted) {
+            qsort(sorted, completed, sizeof(double), compare_doubles);
+            double mean = 0;
+            for (int k = 0; k < completed; k++) mean += sorted[k];
+            mean /= completed;
+            printf("Fairness score distribution:\n");
+            printf("  min %.4f  p25 %.4f  median %.4f  p75 %.4f  max %.4f  mean %.4f\n",
+                   sorted[0], sorted[completed / 4], sorted[completed / 2],
+                   sorted[(completed * 3) / 4], sorted[completed - 1], mean);
+        }
+        printf("Best run: #%d (%s), score %.4f\n", best,
+               best == 0 ? "deterministic" : "randomized", ms.scores[best]);
+        
+        /* Update plan */
+        app->currentPlan.numDistricts = numDistricts;
+        app->hasPlan = 1;
+        print_automap_summary(app);
+    }
+    
+    for (int k = 0; k < starts; k++) {
+        free(ms.assignments[k]);
+    }
+    free(ms.assignments);
+    free(ms.scores);
+    free(sorted);
+    return ok;
+}
+
 /* Print automap generation summary */
 void print_automap_summary(AppState* app) {
     int numDistricts = app->currentPlan.numDistricts;
@@ -419,15 +958,15 @@ void print_automap_summary(AppState* app) {
     int districtsWithData = 0;
     
     printf("\nDistrict Results:\n");
-    printf("%-8s %-12s %-10s %-10s %-8s %s\n", 
+    printf("%-8s %-12s %-10s %-10s %-8s %s\n",
            "District", "Population", "Dem Votes", "Rep Votes", "Dem%", "Result");
-    printf("%-8s %-12s %-10s %-10s %-8s %s\n", 
+    printf("%-8s %-12s %-10s %-10s %-8s %s\n",
            "--------", "------------", "----------", "----------", "--------", "------");
     
     for (int d = 1; d <= numDistricts; d++) {
         int pop = 0, dem = 0, rep = 0;
         double demShare;
-        get_district_stats_quick(app, d, &pop, &dem, &rep, &demShare);
+        get_district_stats_quick(&app->ledger, d, &pop, &dem, &rep, &demShare);
         
         if (pop == 0) {
             printf("%-8d %-12s %-10s %-10s %-8s %s\n", d, "---", "---", "---", "---", "---");
@@ -0,0 +1,215 @@
+/*
+ * US Redistricting Tool - Batch Mode
+ *
+ * Runs one load / automap / metrics / save job from the command line with
+ * no console UI:
+ *
+ *   redistricting run --state NC --districts 14 --preset fair --seed 7
+ *                     --out plan.json --metrics metrics.json
+ *
+ * Progress messages go to stderr. stdout carries a single line of JSON
+ * describing the result (the metrics document on success, the error
+ * otherwise), and the exit code is a BatchStatus, so job runners can chain
+ * jobs without parsing log text.
+ */
+
+#include "../include/maps.h"
+#include "../lib/cJSON.h"
+
+#ifdef _WIN32
+#include <io.h>
+#define dup _dup
+#define dup2 _dup2
+#define fileno _fileno
+#else
+#include <unistd.h>
+#endif
+
+extern int write_file(const char* path, const char* content);
+
+/* The original stdout, kept for the result line; -1 until captured */
+static int resultFd = -1;
+
+/* Send everything printed to stdout to stderr from here on, keeping the
+   original stdout for the result line */
+int batch_capture_stdout(void) {
+    fflush(stdout);
+    resultFd = dup(fileno(stdout));
+    if (resultFd < 0 || dup2(fileno(stderr), fileno(stdout)) < 0) {
+        fprintf(stderr, "Cannot redirect standard output.\n");
+        return 0;
+    }
+    return 1;
+}
+
+/* Write one line of JSON to the original stdout */
+static void emit_result(cJSON* result) {
+    char* text = cJSON_PrintUnformatted(result);
+    if (!text) return;
+    fflush(stdout);
+    FILE* out = resultFd >= 0 ? fdopen(resultFd, "w") : stdout;
+    if (out) {
+        fprintf(out, "%s\n", text);
+        fflush(out);
+    }
+    free(text);
+}
+
+/* Report a failed job and return its exit code */
+static int batch_fail(BatchStatus status, const char* message) {
+    fprintf(stderr, "Error: %s\n", message);
+    cJSON* result = cJSON_CreateObject();
+    cJSON_AddStringToObject(result, "status", "error");
+    cJSON_AddNumberToObject(result, "exitCode", status);
+    cJSON_AddStringToObject(result, "error", message);
+    emit_result(result);
+    cJSON_Delete(result);
+    return status;
+}
+
+/* Report a bad command line the same way as any other failed job */
+int batch_usage_error(const char* message) {
+    return batch_fail(BATCH_USAGE, message);
+}
+
+/* Metrics document for the current plan */
+static cJSON* create_metrics_json(AppState* app, const BatchOptions* options, double elapsed) {
+    int numDistricts = app->currentPlan.numDistricts;
+    DistrictStats stats[MAX_DISTRICTS];
+    compute_district_stats(app, stats, numDistricts);
+    PlanSummary summary;
+    summarize_plan(app, app->district, &app->ledger, numDistricts, &summary);
+
+    long totalPop = 0;
+    for (int d = 1; d <= numDistricts; d++) {
+        totalPop += stats[d - 1].population;
+    }
+    double idealPop = (double)totalPop / numDistricts;
+    int populated = 0;
+    for (int d = 1; d <= numDistricts; d++) {
+        if (stats[d - 1].precinctCount > 0) populated++;
+    }
+
+    cJSON* root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "status", "ok");
+    cJSON_AddStringToObject(root, "state", app->currentPlan.state);
+    cJSON_AddStringToObject(root, "planId", app->currentPlan.planId);
+    cJSON_AddStringToObject(root, "name", app->currentPlan.name);
+    cJSON_AddNumberToObject(root, "numDistricts", numDistricts);
+    cJSON_AddStringToObject(root, "preset", FAIRNESS_PRESETS[options->preset].label);
+    cJSON_AddNumberToObject(root, "targetDemShare", options->customTarget > 0 ?
+                            options->customTarget : FAIRNESS_PRESETS[options->preset].targetDemShare);
+    /* A single greedy run is deterministic, so only report a seed that was used */
+    if (app->optimizer == OPTIMIZER_ANNEAL || options->starts > 1) {
+        cJSON_AddNumberToObject(root, "seed", app->anneal.seed);
+    }
+    cJSON_AddNumberToObject(root, "starts", options->starts);
+    cJSON_AddNumberToObject(root, "elapsedSeconds", elapsed);
+
+    cJSON* totals = cJSON_CreateObject();
+    cJSON_AddNumberToObject(totals, "demSeats", summary.demSeats);
+    cJSON_AddNumberToObject(totals, "repSeats", populated - summary.demSeats);
+    cJSON_AddNumberToObject(totals, "efficiencyGap", summary.efficiencyGap);
+    cJSON_AddNumberToObject(totals, "maxDeviation", summary.maxDeviation);
+    cJSON_AddNumberToObject(totals, "compactness", summary.compactness);
+    cJSON_AddNumberToObject(totals, "unassignedPrecincts", app->ledger.precinctCount[0]);
+    cJSON_AddItemToObject(root, "summary", totals);
+
+    cJSON* districts = cJSON_CreateArray();
+    for (int d = 1; d <= numDistricts; d++) {
+        const DistrictStats* s = &stats[d - 1];
+        cJSON* item = cJSON_CreateObject();
+        cJSON_AddNumberToObject(item, "district", d);
+        cJSON_AddNumberToObject(item, "population", s->population);
+        cJSON_AddNumberToObject(item, "deviation",
+                                idealPop > 0 ? 100.0 * (s->population - idealPop) / idealPop : 0);
+        cJSON_AddNumberToObject(item, "demVotes", s->demVotes);
+        cJSON_AddNumberToObject(item, "repVotes", s->repVotes);
+        cJSON_AddNumberToObject(item, "demShare", s->demShare);
+        cJSON_AddNumberToObject(item, "compactness", s->compactness);
+        cJSON_AddNumberToObject(item, "precincts", s->precinctCount);
+        cJSON_AddNumberToObject(item, "counties", s->countyCount);
+        cJSON_AddItemToArray(districts, item);
+    }
+    cJSON_AddItemToObject(root, "districts", districts);
+    return root;
+}
+
+/* Run one batch job; returns its exit code */
+int run_batch(AppState* app, const BatchOptions* options) {
+    char message[MAX_PATH_LEN + 64];
+
+    if (!options->state[0]) {
+        return batch_fail(BATCH_USAGE, "--state is required");
+    }
+    if (!load_states_list(app)) {
+        snprintf(message, sizeof(message), "no state data found in %s", app->dataDir);
+        return batch_fail(BATCH_LOAD_FAILED, message);
+    }
+    if (!load_state_data(app, options->state)) {
+        snprintf(message, sizeof(message), "cannot load state %s", options->state);
+        return batch_fail(BATCH_LOAD_FAILED, message);
+    }
+
+    create_new_plan(app, options->planName[0] ? options->planName : "Batch Plan");
+    int numDistricts = options->numDistricts > 0 ? options->numDistricts :
+                       app->currentPlan.numDistricts;
+    if (numDistricts < 1 || numDistricts > MAX_DISTRICTS) {
+        return batch_fail(BATCH_USAGE, "district count must be between 1 and 100");
+    }
+    app->currentPlan.numDistricts = numDistricts;
+    if (options->planId[0]) {
+        memcpy(app->currentPlan.planId, options->planId, sizeof(app->currentPlan.planId));
+    }
+    if (options->save && saved_plan_exists(app, app->currentPlan.planId)) {
+        snprintf(message, sizeof(message), "plan %s already exists in the plans directory",
+                 app->currentPlan.planId);
+        return batch_fail(BATCH_WRITE_FAILED, message);
+    }
+
+    double started = monotonic_seconds();
+    int ok;
+    if (options->starts > 1) {
+        ok = generate_automap_multistart(app, numDistricts, options->preset, options->customTarget,
+                                         options->starts, app->anneal.seed);
+    } else {
+        ok = generate_automap(app, numDistricts, options->preset, options->customTarget);
+    }
+    double elapsed = monotonic_seconds() - started;
+    if (!ok) {
+        return batch_fail(BATCH_AUTOMAP_FAILED, "automap failed");
+    }
+
+    if (options->outPath[0]) {
+        const char* ext = strrchr(options->outPath, '.');
+        if (ext && strcmp(ext, ".plan") == 0) {
+            ok = save_plan_binary(app, options->outPath);
+        } else {
+            ok = export_plan_json(app, options->outPath);
+        }
+        if (!ok) {
+            snprintf(message, sizeof(message), "cannot write plan to %s", options->outPath);
+            return batch_fail(BATCH_WRITE_FAILED, message);
+        }
+        printf("Plan written to %s\n", options->outPath);
+    }
+    if (options->save && !save_plan(app)) {
+        return batch_fail(BATCH_WRITE_FAILED, "cannot save plan to the plans directory");
+    }
+
+    cJSON* metrics = create_metrics_json(app, options, elapsed);
+    if (options->metricsPath[0]) {
+        char* metricsJson = cJSON_Print(metrics);
+        ok = metricsJson && write_file(options->metricsPath, metricsJson);
+        free(metricsJson);
+        if (!ok) {
+            cJSON_Delete(metrics);
+            snprintf(message, sizeof(message), "cannot write metrics to %s", options->metricsPath);
+            return batch_fail(BATCH_WRITE_FAILED, message);
+        }
+        printf("Metrics written to %s\n", options->metricsPath);
+    }
+    emit_result(metrics);
+    cJSON_Delete(metrics);
+    return BATCH_OK;
+}
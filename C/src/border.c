@@ -0,0 +1,126 @@
+/*
+ * US Redistricting Tool - District Border Set
+ *
+ * Tracks which precincts sit on a district boundary and keeps a FIFO
+ * worklist of (precinct, adjacent district) candidate moves. When a
+ * precinct changes district only it and its graph neighbors can change
+ * border status, so border_moved refreshes just those. A refresh bumps the
+ * precinct's version; queued candidates from an older version are dropped
+ * when they reach the front, so nothing is ever searched for in the queue.
+ *
+ * The set reads whichever assignment array it is given, so it can follow
+ * the working plan or a private copy.
+ */
+
+#include "../include/maps.h"
+
+/* Queue one candidate, growing and compacting the worklist as needed */
+static int border_push(BorderSet* set, int precinct, int district) {
+    if (set->tail >= set->capacity) {
+        if (set->head > set->capacity / 2) {
+            /* Reclaim the consumed front instead of growing */
+            int pending = set->tail - set->head;
+            memmove(set->queue, set->queue + set->head, sizeof(BorderCandidate) * pending);
+            set->head = 0;
+            set->tail = pending;
+        } else {
+            int newCap = set->capacity ? set->capacity * 2 : 1024;
+            BorderCandidate* grown = (BorderCandidate*)realloc(set->queue, sizeof(BorderCandidate) * newCap);
+            if (!grown) return 0;
+            set->queue = grown;
+            set->capacity = newCap;
+        }
+    }
+    
+    BorderCandidate* c = &set->queue[set->tail++];
+    c->precinct = precinct;
+    c->district = district;
+    c->version = set->version[precinct];
+    return 1;
+}
+
+/* Recompute one precinct's border bit and queue a candidate per adjacent district */
+static int border_refresh(BorderSet* set, const AppState* app, const int* district, int precinct) {
+    const AdjacencyGraph* g = &app->adjacency;
+    int own = district[precinct];
+    int pushed = 0;
+    
+    set->version[precinct]++;
+    set->bits[precinct >> 6] &= ~(1ULL << (precinct & 63));
+    if (own == 0) return 1;
+    
+    for (int k = g->offsets[precinct]; k < g->offsets[precinct + 1]; k++) {
+        int d = district[g->neighbors[k]];
+        if (d == 0 || d == own) continue;
+        
+        /* Neighbor lists are short; skip districts already queued for this precinct */
+        int seen = 0;
+        for (int q = set->tail - pushed; q < set->tail; q++) {
+            if (set->queue[q].district == d) {
+                seen = 1;
+                break;
+            }
+        }
+        if (seen) continue;
+        
+        if (!border_push(set, precinct, d)) return 0;
+        pushed++;
+        set->bits[precinct >> 6] |= 1ULL << (precinct & 63);
+    }
+    return 1;
+}
+
+/* Build the set for an assignment and queue every border precinct */
+int border_init(BorderSet* set, const AppState* app, const int* district) {
+    memset(set, 0, sizeof(BorderSet));
+    int n = app->precinctCount;
+    set->precinctCount = n;
+    set->bits = (uint64_t*)calloc((size_t)(n + 63) / 64 + 1, sizeof(uint64_t));
+    set->version = (int*)calloc(n > 0 ? n : 1, sizeof(int));
+    if (!set->bits || !set->version) {
+        border_free(set);
+        return 0;
+    }
+    
+    for (int i = 0; i < n; i++) {
+        if (!border_refresh(set, app, district, i)) {
+            border_free(set);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void border_free(BorderSet* set) {
+    free(set->bits);
+    free(set->version);
+    free(set->queue);
+    memset(set, 0, sizeof(BorderSet));
+}
+
+int border_contains(const BorderSet* set, int precinct) {
+    return (set->bits[precinct >> 6] >> (precinct & 63)) & 1;
+}
+
+/* Take the next current candidate; returns 0 once the worklist is empty */
+int border_next(BorderSet* set, BorderCandidate* out) {
+    while (set->head < set->tail) {
+        BorderCandidate c = set->queue[set->head++];
+        if (c.version == set->version[c.precinct]) {
+            *out = c;
+            return 1;
+        }
+    }
+    set->head = set->tail = 0;
+    return 0;
+}
+
+/* Refresh a precinct that just changed district and its neighbors */
+int border_moved(BorderSet* set, const AppState* app, const int* district, int precinct) {
+    const AdjacencyGraph* g = &app->adjacency;
+    if (!border_refresh(set, app, district, precinct)) return 0;
+    for (int k = g->offsets[precinct]; k < g->offsets[precinct + 1]; k++) {
+        if (!border_refresh(set, app, district, g->neighbors[k])) return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,333 @@
+/*
+ * US Redistricting Tool - Binary Precinct Cache
+ *
+ * Parsing a large precincts.geojson and rebuilding adjacency takes seconds,
+ * so the result is written next to it as precincts.cache on first load and
+ * memory-mapped on later loads. The adjacency arrays are used in place from
+ * the mapping, which stays open in app->cacheMap while the state is loaded.
+ *
+ * File layout (native byte order, all sections 8-byte aligned):
+ *   CacheHeader
+ *   CacheRecord[precinctCount]          precinct attributes, centroid, bounds
+ *   char[countyCount][MAX_NAME_LEN]     interned county names
+ *   int32_t[precinctCount + 1]          adjacency row offsets (CSR)
+ *   int32_t[edgeCount]                  adjacency neighbor indices (CSR)
+ *   double[edgeCount]                   shared boundary lengths (if flagged)
+ *
+ * The cache is ignored and rebuilt when its version or record layout does not
+ * match this build, when it was built with a different adjacency mode, or
+ * when the source file's size, modification time or content fingerprint has
+ * changed.
+ */
+
+#include "../include/maps.h"
+
+#ifdef _WIN32
+#include <sys/stat.h>
+#endif
+
+#define CACHE_MAGIC "PRCACHE"
+#define CACHE_VERSION 3
+#define CACHE_HAS_WEIGHTS 0x1
+#define CACHE_SAMPLE_BYTES (64 * 1024)
+#define CACHE_ALIGN(n) (((n) + 7) & ~(uint64_t)7)
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t sourceSize;
+    int64_t sourceMtime;
+    uint64_t sourceHash;
+    uint32_t precinctCount;
+    uint32_t countyCount;
+    uint32_t edgeCount;
+    uint32_t adjacencyMode;
+    uint32_t flags;
+    uint32_t reserved;
+    uint64_t recordsOffset;
+    uint64_t countiesOffset;
+    uint64_t adjOffsetsOffset;
+    uint64_t adjNeighborsOffset;
+    uint64_t adjWeightsOffset;
+    uint64_t totalSize;
+} CacheHeader;
+
+typedef struct {
+    char id[MAX_ID_LEN];
+    int32_t population;
+    int32_t dem;
+    int32_t rep;
+    int32_t county;
+    double centroidX;
+    double centroidY;
+    BoundingBox bounds;
+} CacheRecord;
+
+/* Build the cache path that sits next to precincts.geojson */
+static void get_cache_path(const char* geoPath, char* buffer, size_t size) {
+    strncpy(buffer, geoPath, size - 1);
+    buffer[size - 1] = '\0';
+
+    char* dot = strrchr(buffer, '.');
+    char* sep = strrchr(buffer, PATH_SEP[0]);
+    if (dot && (!sep || dot > sep)) {
+        *dot = '\0';
+    }
+    strncat(buffer, ".cache", size - strlen(buffer) - 1);
+}
+
+/* Size, mtime and a fingerprint of the head and tail of the source file */
+static int fingerprint_source(const char* geoPath, uint64_t* size, int64_t* mtime, uint64_t* hash) {
+    struct stat st;
+    if (stat(geoPath, &st) != 0) {
+        return 0;
+    }
+    *size = (uint64_t)st.st_size;
+    *mtime = (int64_t)st.st_mtime;
+
+    FILE* file = fopen(geoPath, "rb");
+    if (!file) {
+        return 0;
+    }
+
+    unsigned char* sample = (unsigned char*)malloc(CACHE_SAMPLE_BYTES);
+    if (!sample) {
+        fclose(file);
+        return 0;
+    }
+
+    uint64_t h = hash_bytes(size, sizeof(*size), 0);
+    size_t n = fread(sample, 1, CACHE_SAMPLE_BYTES, file);
+    h = hash_bytes(sample, n, h);
+
+    if (*size > CACHE_SAMPLE_BYTES) {
+        fseek(file, -(long)CACHE_SAMPLE_BYTES, SEEK_END);
+        n = fread(sample, 1, CACHE_SAMPLE_BYTES, file);
+        h = hash_bytes(sample, n, h);
+    }
+
+    free(sample);
+    fclose(file);
+    *hash = h;
+    return 1;
+}
+
+/* Load precincts from a valid cache; returns 0 if missing or stale */
+int load_precinct_cache(AppState* app, const char* geoPath) {
+    char cachePath[MAX_PATH_LEN];
+    get_cache_path(geoPath, cachePath, sizeof(cachePath));
+
+    if (!file_exists(cachePath)) {
+        return 0;
+    }
+
+    uint64_t sourceSize, sourceHash;
+    int64_t sourceMtime;
+    if (!fingerprint_source(geoPath, &sourceSize, &sourceMtime, &sourceHash)) {
+        return 0;
+    }
+
+    MappedFile map;
+    if (!map_file(cachePath, &map)) {
+        return 0;
+    }
+
+    const CacheHeader* h = (const CacheHeader*)map.data;
+    int valid = map.size >= sizeof(CacheHeader) &&
+                memcmp(h->magic, CACHE_MAGIC, sizeof(h->magic)) == 0 &&
+                h->version == CACHE_VERSION &&
+                h->recordSize == sizeof(CacheRecord) &&
+                h->totalSize == map.size &&
+                h->sourceSize == sourceSize &&
+                h->sourceMtime == sourceMtime &&
+                h->sourceHash == sourceHash &&
+                h->adjacencyMode == (uint32_t)app->adjacencyMode &&
+                h->precinctCount < INT32_MAX &&
+                h->recordsOffset + (uint64_t)h->precinctCount * sizeof(CacheRecord) <= map.size &&
+                h->countiesOffset + (uint64_t)h->countyCount * MAX_NAME_LEN <= map.size &&
+                h->adjOffsetsOffset + ((uint64_t)h->precinctCount + 1) * sizeof(int32_t) <= map.size &&
+                h->adjNeighborsOffset + (uint64_t)h->edgeCount * sizeof(int32_t) <= map.size &&
+                (!(h->flags & CACHE_HAS_WEIGHTS) ||
+                 h->adjWeightsOffset + (uint64_t)h->edgeCount * sizeof(double) <= map.size);
+
+    if (!valid) {
+        printf("Precinct cache is stale, rebuilding.\n");
+        unmap_file(&map);
+        return 0;
+    }
+
+    const CacheRecord* records = (const CacheRecord*)(map.data + h->recordsOffset);
+    const char* counties = (const char*)(map.data + h->countiesOffset);
+    const int32_t* adjOffsets = (const int32_t*)(map.data + h->adjOffsetsOffset);
+    const int32_t* adjNeighbors = (const int32_t*)(map.data + h->adjNeighborsOffset);
+    const double* adjWeights = (h->flags & CACHE_HAS_WEIGHTS) ?
+                               (const double*)(map.data + h->adjWeightsOffset) : NULL;
+
+    /* Offsets must be monotonic and every neighbor a valid precinct (with a
+       finite weight) before the graph is trusted */
+    valid = adjOffsets[0] == 0 && (uint32_t)adjOffsets[h->precinctCount] == h->edgeCount;
+    for (uint32_t i = 0; valid && i < h->precinctCount; i++) {
+        valid = adjOffsets[i] <= adjOffsets[i + 1] &&
+                records[i].county >= 0 && (uint32_t)records[i].county < h->countyCount;
+        for (int32_t k = adjOffsets[i]; valid && k < adjOffsets[i + 1]; k++) {
+            valid = adjNeighbors[k] >= 0 && (uint32_t)adjNeighbors[k] < h->precinctCount &&
+                    (!adjWeights || isfinite(adjWeights[k]));
+        }
+    }
+    if (!valid) {
+        printf("Precinct cache is corrupt, rebuilding.\n");
+        unmap_file(&map);
+        return 0;
+    }
+
+    if (!reserve_precincts(app, (int)h->precinctCount)) {
+        unmap_file(&map);
+        return 0;
+    }
+
+    /* Interning in stored order reproduces the cached ids */
+    free_county_table(&app->counties);
+    for (uint32_t c = 0; c < h->countyCount; c++) {
+        if (intern_county(&app->counties, counties + (size_t)c * MAX_NAME_LEN) != (int)c) {
+            printf("Precinct cache is corrupt, rebuilding.\n");
+            free_county_table(&app->counties);
+            unmap_file(&map);
+            return 0;
+        }
+    }
+
+    AdjacencyGraph* g = &app->adjacency;
+    free_adjacency_graph(g);
+    g->offsets = (int*)adjOffsets;
+    g->neighbors = (int*)adjNeighbors;
+    g->weights = (double*)adjWeights;
+    g->nodeCount = (int)h->precinctCount;
+    g->edgeCount = (int)h->edgeCount;
+    g->borrowed = 1;
+
+    for (uint32_t i = 0; i < h->precinctCount; i++) {
+        const CacheRecord* r = &records[i];
+        Precinct* p = &app->precincts[i];
+        memset(p, 0, sizeof(Precinct));
+
+        p->index = (int)i;
+        memcpy(p->id, r->id, sizeof(p->id));
+        p->id[sizeof(p->id) - 1] = '\0';
+        app->population[i] = r->population;
+        app->dem[i] = r->dem;
+        app->rep[i] = r->rep;
+        app->district[i] = 0;
+        app->countyId[i] = r->county;
+        p->centroid.x = r->centroidX;
+        p->centroid.y = r->centroidY;
+        p->bounds = r->bounds;
+
+        int totalVotes = r->dem + r->rep;
+        p->demShare = totalVotes > 0 ? (double)r->dem / totalVotes : 0.5;
+    }
+    app->precinctCount = (int)h->precinctCount;
+
+    /* Keep the mapping alive for the borrowed adjacency arrays */
+    unmap_file(&app->cacheMap);
+    app->cacheMap = map;
+    return 1;
+}
+
+/* Write the cache for the currently loaded precincts */
+int save_precinct_cache(AppState* app, const char* geoPath) {
+    char cachePath[MAX_PATH_LEN];
+    char tempPath[MAX_PATH_LEN + 8];
+    get_cache_path(geoPath, cachePath, sizeof(cachePath));
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", cachePath);
+
+    CacheHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CACHE_MAGIC, sizeof(h.magic));
+    h.version = CACHE_VERSION;
+    h.recordSize = sizeof(CacheRecord);
+    h.adjacencyMode = (uint32_t)app->adjacencyMode;
+    if (!fingerprint_source(geoPath, &h.sourceSize, &h.sourceMtime, &h.sourceHash)) {
+        return 0;
+    }
+
+    int n = app->precinctCount;
+    AdjacencyGraph* g = &app->adjacency;
+    if (g->nodeCount != n) {
+        return 0;
+    }
+
+    CacheRecord* records = (CacheRecord*)calloc(n > 0 ? n : 1, sizeof(CacheRecord));
+    if (!records) {
+        return 0;
+    }
+
+    int countyCount = app->counties.count;
+    for (int i = 0; i < n; i++) {
+        Precinct* p = &app->precincts[i];
+        CacheRecord* r = &records[i];
+        memcpy(r->id, p->id, sizeof(r->id));
+        r->population = app->population[i];
+        r->dem = app->dem[i];
+        r->rep = app->rep[i];
+        r->county = app->countyId[i];
+        r->centroidX = p->centroid.x;
+        r->centroidY = p->centroid.y;
+        r->bounds = p->bounds;
+    }
+
+    h.precinctCount = (uint32_t)n;
+    h.countyCount = (uint32_t)countyCount;
+    h.edgeCount = (uint32_t)g->edgeCount;
+    h.flags = g->weights ? CACHE_HAS_WEIGHTS : 0;
+    h.recordsOffset = CACHE_ALIGN(sizeof(CacheHeader));
+    h.countiesOffset = CACHE_ALIGN(h.recordsOffset + (uint64_t)n * sizeof(CacheRecord));
+    h.adjOffsetsOffset = CACHE_ALIGN(h.countiesOffset + (uint64_t)countyCount * MAX_NAME_LEN);
+    h.adjNeighborsOffset = CACHE_ALIGN(h.adjOffsetsOffset + ((uint64_t)n + 1) * sizeof(int32_t));
+    h.adjWeightsOffset = CACHE_ALIGN(h.adjNeighborsOffset + (uint64_t)h.edgeCount * sizeof(int32_t));
+    h.totalSize = g->weights ? h.adjWeightsOffset + (uint64_t)h.edgeCount * sizeof(double)
+                             : h.adjNeighborsOffset + (uint64_t)h.edgeCount * sizeof(int32_t);
+
+    int ok = 0;
+    FILE* file = fopen(tempPath, "wb");
+    if (file) {
+        static const char zeros[8] = {0};
+        ok = fwrite(&h, sizeof(h), 1, file) == 1;
+
+        ok = ok && fwrite(zeros, 1, h.recordsOffset - sizeof(h), file) == h.recordsOffset - sizeof(h);
+        ok = ok && fwrite(records, sizeof(CacheRecord), n, file) == (size_t)n;
+
+        uint64_t pos = h.recordsOffset + (uint64_t)n * sizeof(CacheRecord);
+        ok = ok && fwrite(zeros, 1, h.countiesOffset - pos, file) == h.countiesOffset - pos;
+        ok = ok && fwrite(app->counties.names, MAX_NAME_LEN, countyCount, file) == (size_t)countyCount;
+
+        pos = h.countiesOffset + (uint64_t)countyCount * MAX_NAME_LEN;
+        ok = ok && fwrite(zeros, 1, h.adjOffsetsOffset - pos, file) == h.adjOffsetsOffset - pos;
+        ok = ok && fwrite(g->offsets, sizeof(int32_t), n + 1, file) == (size_t)(n + 1);
+
+        pos = h.adjOffsetsOffset + ((uint64_t)n + 1) * sizeof(int32_t);
+        ok = ok && fwrite(zeros, 1, h.adjNeighborsOffset - pos, file) == h.adjNeighborsOffset - pos;
+        ok = ok && fwrite(g->neighbors, sizeof(int32_t), h.edgeCount, file) == h.edgeCount;
+
+        if (g->weights) {
+            pos = h.adjNeighborsOffset + (uint64_t)h.edgeCount * sizeof(int32_t);
+            ok = ok && fwrite(zeros, 1, h.adjWeightsOffset - pos, file) == h.adjWeightsOffset - pos;
+            ok = ok && fwrite(g->weights, sizeof(double), h.edgeCount, file) == h.edgeCount;
+        }
+
+        ok = (fclose(file) == 0) && ok;
+    }
+
+    free(records);
+
+    if (ok) {
+        remove(cachePath);
+        ok = rename(tempPath, cachePath) == 0;
+    }
+    if (!ok) {
+        remove(tempPath);
+        fprintf(stderr, "Warning: could not write precinct cache: %s\n", cachePath);
+    }
+
+    return ok;
+}
@@ -0,0 +1,253 @@
+/*
+ * US Redistricting Tool - Contiguity Checks
+ *
+ * Answers "does taking precinct p out of its district split the district?"
+ * for single-precinct moves, in increasing order of cost:
+ *
+ * 1. Local: p's same-district neighbors connect to each other through
+ *    precincts at most two steps from p (the usual case inside a district).
+ * 2. Cached: the district's articulation points are known and the district
+ *    has not changed since; p splits it exactly when it is one of them.
+ * 3. Bounded search: walk the district from one of p's neighbors, avoiding
+ *    p, until every other neighbor is reached. After CONTIGUITY_BFS_LIMIT
+ *    precincts the search gives way to Tarjan's algorithm over p's piece of
+ *    the district, and the articulation points it finds are cached.
+ *
+ * Every answer is exact. A district that is already in several pieces is
+ * judged piece by piece: a move is allowed if it does not split the piece
+ * p belongs to. Callers report each move with contiguity_moved so stale
+ * caches are dropped; a district's cache stays valid across any number of
+ * rejected proposals.
+ */
+
+#include "../include/maps.h"
+
+/* Precincts a bounded search visits before computing articulation points */
+#define CONTIGUITY_BFS_LIMIT 256
+
+static void contiguity_release(ContiguityChecker* c) {
+    free(c->stamp);
+    free(c->queue);
+    free(c->disc);
+    free(c->low);
+    free(c->parent);
+    free(c->cursor);
+    free(c->cutStamp);
+    free(c->isCut);
+}
+
+void contiguity_free(ContiguityChecker* c) {
+    contiguity_release(c);
+    memset(c, 0, sizeof(ContiguityChecker));
+}
+
+/* Size the checker for the loaded state and drop every cached answer */
+int contiguity_init(ContiguityChecker* c, const AppState* app) {
+    int n = app->precinctCount;
+    if (c->precinctCount != n || !c->stamp) {
+        contiguity_release(c);
+        memset(c, 0, sizeof(ContiguityChecker));
+        int size = n > 0 ? n : 1;
+        c->stamp = (int*)calloc(size, sizeof(int));
+        c->queue = (int*)malloc(sizeof(int) * size);
+        c->disc = (int*)malloc(sizeof(int) * size);
+        c->low = (int*)malloc(sizeof(int) * size);
+        c->parent = (int*)malloc(sizeof(int) * size);
+        c->cursor = (int*)malloc(sizeof(int) * size);
+        c->cutStamp = (int*)calloc(size, sizeof(int));
+        c->isCut = (char*)calloc(size, 1);
+        if (!c->stamp || !c->queue || !c->disc || !c->low || !c->parent ||
+            !c->cursor || !c->cutStamp || !c->isCut) {
+            contiguity_free(c);
+            fprintf(stderr, "Out of memory allocating contiguity checker.\n");
+            return 0;
+        }
+        c->precinctCount = n;
+    }
+    c->graph = &app->adjacency;
+    memset(c->cacheToken, 0, sizeof(c->cacheToken));
+    c->localHits = c->cacheHits = c->searchHits = c->articulationRuns = 0;
+    return 1;
+}
+
+/* Forget cached answers for the two districts a precinct moved between */
+void contiguity_moved(ContiguityChecker* c, int from, int to) {
+    if (from >= 0 && from <= MAX_DISTRICTS) c->cacheToken[from] = 0;
+    if (to >= 0 && to <= MAX_DISTRICTS) c->cacheToken[to] = 0;
+}
+
+/* Next search mark; clears the stamps on the rare wraparound */
+static int next_mark(ContiguityChecker* c) {
+    if (++c->generation <= 0) {
+        memset(c->stamp, 0, sizeof(int) * c->precinctCount);
+        c->generation = 1;
+    }
+    return c->generation;
+}
+
+/* Articulation points of the district piece containing start (Tarjan,
+   iterative), cached under the district's current token */
+static void find_articulation_points(ContiguityChecker* c, const int* district, int start) {
+    const AdjacencyGraph* g = c->graph;
+    int d = district[start];
+    if (c->cacheToken[d] == 0) {
+        if (++c->nextToken <= 0) {
+            /* Token wraparound: drop every cached flag */
+            memset(c->cutStamp, 0, sizeof(int) * c->precinctCount);
+            memset(c->cacheToken, 0, sizeof(c->cacheToken));
+            c->nextToken = 1;
+        }
+        c->cacheToken[d] = c->nextToken;
+    }
+    int token = c->cacheToken[d];
+    int* stack = c->queue;
+    int time = 0;
+    int top = 0;
+    int rootChildren = 0;
+
+    c->cutStamp[start] = token;
+    c->isCut[start] = 0;
+    c->disc[start] = c->low[start] = time++;
+    c->parent[start] = -1;
+    c->cursor[start] = g->offsets[start];
+    stack[top++] = start;
+
+    while (top > 0) {
+        int v = stack[top - 1];
+        if (c->cursor[v] < g->offsets[v + 1]) {
+            int w = g->neighbors[c->cursor[v]++];
+            if (district[w] != d) continue;
+            if (c->cutStamp[w] != token) {
+                c->cutStamp[w] = token;
+                c->isCut[w] = 0;
+                c->disc[w] = c->low[w] = time++;
+                c->parent[w] = v;
+                c->cursor[w] = g->offsets[w];
+                stack[top++] = w;
+                if (v == start) rootChildren++;
+            } else if (w != c->parent[v] && c->disc[w] < c->low[v]) {
+                c->low[v] = c->disc[w];
+            }
+        } else {
+            top--;
+            int u = c->parent[v];
+            if (u < 0) continue;
+            if (c->low[v] < c->low[u]) c->low[u] = c->low[v];
+            if (u != start && c->low[v] >= c->disc[u]) c->isCut[u] = 1;
+        }
+    }
+    c->isCut[start] = rootChildren > 1;
+    c->articulationRuns++;
+}
+
+/* Whether taking a precinct out of its district leaves the rest of its
+   piece of the district connected */
+int contiguity_removal_ok(ContiguityChecker* c, const int* district, int precinct) {
+    const AdjacencyGraph* g = c->graph;
+    int d = district[precinct];
+    int first = g->offsets[precinct];
+    int last = g->offsets[precinct + 1];
+
+    /* Same-district neighbors, marked for the checks below */
+    int mark = next_mark(c);
+    int targets = 0;
+    int start = -1;
+    for (int k = first; k < last; k++) {
+        int n = g->neighbors[k];
+        if (district[n] == d) {
+            c->stamp[n] = mark;
+            targets++;
+            start = n;
+        }
+    }
+    if (targets <= 1) {
+        c->localHits++;
+        return 1;
+    }
+
+    /* 1. Local: connect the neighbors through same-district precincts at
+       most two steps from the precinct */
+    int ring = next_mark(c);
+    for (int k = first; k < last; k++) {
+        int t = g->neighbors[k];
+        if (c->stamp[t] != mark) continue;
+        for (int j = g->offsets[t]; j < g->offsets[t + 1]; j++) {
+            int w = g->neighbors[j];
+            if (w != precinct && c->stamp[w] != mark && district[w] == d) c->stamp[w] = ring;
+        }
+    }
+    int head = 0, tail = 0;
+    int seen = next_mark(c);
+    int reached = 1;
+    c->queue[tail++] = start;
+    c->stamp[start] = seen;
+    while (head < tail && reached < targets) {
+        int v = c->queue[head++];
+        for (int k = g->offsets[v]; k < g->offsets[v + 1]; k++) {
+            int n = g->neighbors[k];
+            if (c->stamp[n] == mark || c->stamp[n] == ring) {
+                if (c->stamp[n] == mark) reached++;
+                c->stamp[n] = seen;
+                c->queue[tail++] = n;
+            }
+        }
+    }
+    if (reached == targets) {
+        c->localHits++;
+        return 1;
+    }
+
+    /* 2. Cached articulation points */
+    int token = d >= 0 && d <= MAX_DISTRICTS ? c->cacheToken[d] : 0;
+    if (token != 0 && c->cutStamp[precinct] == token) {
+        c->cacheHits++;
+        return !c->isCut[precinct];
+    }
+
+    /* 3. Bounded search from one neighbor for the rest, avoiding the precinct */
+    mark = next_mark(c);
+    c->stamp[precinct] = mark;
+    head = tail = 0;
+    c->queue[tail++] = start;
+    c->stamp[start] = mark;
+    reached = 0;
+    while (head < tail && tail <= CONTIGUITY_BFS_LIMIT) {
+        int v = c->queue[head++];
+        int adjacent = 0;
+        for (int k = g->offsets[v]; k < g->offsets[v + 1]; k++) {
+            int n = g->neighbors[k];
+            if (n == precinct) {
+                adjacent = 1;
+            } else if (c->stamp[n] != mark && district[n] == d) {
+                c->stamp[n] = mark;
+                c->queue[tail++] = n;
+            }
+        }
+        if (adjacent && ++reached == targets) {
+            c->searchHits++;
+            return 1;
+        }
+    }
+    if (head == tail) {
+        /* Search ran dry before reaching every neighbor */
+        c->searchHits++;
+        return 0;
+    }
+
+    /* Large piece: compute its articulation points once and reuse them */
+    if (d < 0 || d > MAX_DISTRICTS) return 0;
+    find_articulation_points(c, district, precinct);
+    return !c->isCut[precinct];
+}
+
+/* Whether adding a precinct to a district touches the district (or the
+   district is empty), so the move creates no detached piece */
+int contiguity_addition_ok(const ContiguityChecker* c, const DistrictLedger* ledger,
+                           const int* district, int precinct, int to) {
+    const AdjacencyGraph* g = c->graph;
+    if (to <= 0 || to > MAX_DISTRICTS || ledger->precinctCount[to] == 0) return 1;
+    for (int k = g->offsets[precinct]; k < g->offsets[precinct + 1]; k++) {
+        if (district[g->neighbors[k]] == to) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,288 @@
+/*
+ * US Redistricting Tool - Ensemble Analysis
+ *
+ * Places the current plan within a distribution of alternative plans.
+ * Independent ReCom chains start from the current plan and run as tasks on
+ * the thread pool; after a burn-in each chain records a plan every few
+ * steps. Recorded plans are reduced on the spot to a PlanSummary (seats,
+ * efficiency gap, population deviation, compactness) read from the chain's
+ * ledger, so workers allocate nothing once their chain is set up and the
+ * ensemble itself costs a few dozen bytes per plan.
+ *
+ * There are several chains per thread: workers claim chains from the pool's
+ * shared counter, so a thread that finishes early picks up the next chain
+ * instead of idling. The report gives each metric's histogram with the
+ * current plan's bin marked and the current plan's percentile.
+ */
+
+#include "../include/maps.h"
+
+/* Chains per worker thread, so finished workers have chains left to claim */
+#define ENSEMBLE_CHAINS_PER_THREAD 4
+
+/* Bins in the histogram of a continuous metric */
+#define ENSEMBLE_BINS 12
+
+/* Width of the longest histogram bar */
+#define ENSEMBLE_BAR_WIDTH 40
+
+typedef enum {
+    METRIC_SEATS = 0,
+    METRIC_EFFICIENCY_GAP,
+    METRIC_DEVIATION,
+    METRIC_COMPACTNESS,
+    METRIC_COUNT
+} EnsembleMetric;
+
+static const char* METRIC_NAMES[METRIC_COUNT] = {
+    "Democratic seats",
+    "Efficiency gap (%, positive favors R)",
+    "Max population deviation (%)",
+    "Mean compactness (Polsby-Popper)"
+};
+
+static const char* METRIC_FORMATS[METRIC_COUNT] = { "%8.1f", "%+8.2f", "%8.2f", "%8.3f" };
+
+typedef struct {
+    const AppState* app;
+    int numDistricts;
+    int plans;
+    int chains;
+    int burnIn;
+    int thin;
+    double tolerance;
+    uint32_t seed;
+    PlanSummary* results;      /* One per plan, chain c fills its own range */
+    long* steps;               /* Per chain */
+    long* accepted;
+    char* failed;
+} EnsembleJob;
+
+/* First plan index recorded by a chain; chain c records [first(c), first(c + 1)) */
+static int chain_first_plan(const EnsembleJob* job, int chain) {
+    return (int)((long)job->plans * chain / job->chains);
+}
+
+/* Run one chain and summarize each plan it records */
+static void ensemble_task(int task, void* ctx) {
+    EnsembleJob* job = (EnsembleJob*)ctx;
+    RecomChain chain;
+    if (!recom_init(&chain, job->app, job->tolerance, job->seed, (uint32_t)task + 1)) {
+        recom_free(&chain);
+        job->failed[task] = 1;
+        return;
+    }
+
+    long steps = 0;
+    for (int s = 0; s < job->burnIn; s++, steps++) {
+        recom_step(&chain);
+    }
+    int last = chain_first_plan(job, task + 1);
+    for (int p = chain_first_plan(job, task); p < last; p++) {
+        for (int s = 0; s < job->thin; s++, steps++) {
+            recom_step(&chain);
+        }
+        summarize_plan(job->app, chain.district, &chain.ledger, job->numDistricts,
+                       &job->results[p]);
+    }
+
+    job->steps[task] = steps;
+    job->accepted[task] = chain.accepted;
+    recom_free(&chain);
+}
+
+static double metric_value(const PlanSummary* s, int metric) {
+    switch (metric) {
+        case METRIC_SEATS: return s->demSeats;
+        case METRIC_EFFICIENCY_GAP: return s->efficiencyGap;
+        case METRIC_DEVIATION: return s->maxDeviation;
+        default: return s->compactness;
+    }
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/* Value at a fraction of the way through sorted values */
+static double quantile(const double* sorted, int count, double q) {
+    int i = (int)(q * (count - 1) + 0.5);
+    return sorted[i];
+}
+
+/* Print one metric's distribution, marking the current plan */
+static void print_distribution(int metric, const double* sorted, int count, double current) {
+    const char* format = METRIC_FORMATS[metric];
+
+    /* Percentile counts ties as half below */
+    int below = 0, equal = 0;
+    double mean = 0;
+    for (int i = 0; i < count; i++) {
+        if (sorted[i] < current) below++;
+        else if (sorted[i] == current) equal++;
+        mean += sorted[i];
+    }
+    mean /= count;
+
+    printf("\n%s\n", METRIC_NAMES[metric]);
+    printf("  Current plan: ");
+    printf(format, current);
+    printf("   percentile %.1f\n", 100.0 * (below + 0.5 * equal) / count);
+    printf("  Ensemble: mean ");
+    printf(format, mean);
+    printf(", 5%% ");
+    printf(format, quantile(sorted, count, 0.05));
+    printf(", median ");
+    printf(format, quantile(sorted, count, 0.5));
+    printf(", 95%% ");
+    printf(format, quantile(sorted, count, 0.95));
+    printf("\n");
+
+    /* Bins span the ensemble and the current plan; seats get one bin each */
+    double lo = sorted[0] < current ? sorted[0] : current;
+    double hi = sorted[count - 1] > current ? sorted[count - 1] : current;
+    int bins;
+    double width;
+    if (metric == METRIC_SEATS) {
+        bins = (int)(hi - lo) + 1;
+        width = 1;
+    } else {
+        bins = hi > lo ? ENSEMBLE_BINS : 1;
+        width = hi > lo ? (hi - lo) / bins : 1;
+    }
+
+    int counts[MAX_DISTRICTS + 1];
+    memset(counts, 0, sizeof(counts));
+    int peak = 0;
+    for (int i = 0; i < count; i++) {
+        int b = (int)((sorted[i] - lo) / width);
+        if (b >= bins) b = bins - 1;
+        if (++counts[b] > peak) peak = counts[b];
+    }
+    int currentBin = (int)((current - lo) / width);
+    if (currentBin >= bins) currentBin = bins - 1;
+
+    for (int b = 0; b < bins; b++) {
+        printf("  ");
+        printf(format, lo + b * width);
+        printf(" |");
+        int bar = peak > 0 ? (int)((long)counts[b] * ENSEMBLE_BAR_WIDTH / peak) : 0;
+        if (bar == 0 && counts[b] > 0) bar = 1;
+        for (int k = 0; k < bar; k++) {
+            putchar('#');
+        }
+        printf(" %d%s\n", counts[b], b == currentBin ? "  <- current plan" : "");
+    }
+}
+
+/* Write one row of metrics per plan */
+static int write_ensemble_csv(const EnsembleJob* job, const char* outputPath) {
+    FILE* out = fopen(outputPath, "w");
+    if (!out) {
+        fprintf(stderr, "Cannot open output file: %s\n", outputPath);
+        return 0;
+    }
+    int ok = fprintf(out, "plan,chain,demSeats,efficiencyGap,maxDeviation,compactness\n") > 0;
+    for (int c = 0; c < job->chains && ok; c++) {
+        int last = chain_first_plan(job, c + 1);
+        for (int p = chain_first_plan(job, c); p < last && ok; p++) {
+            const PlanSummary* s = &job->results[p];
+            ok = fprintf(out, "%d,%d,%d,%.4f,%.4f,%.5f\n", p + 1, c + 1, s->demSeats,
+                         s->efficiencyGap, s->maxDeviation, s->compactness) > 0;
+        }
+    }
+    if (fclose(out) != 0) ok = 0;
+    if (!ok) {
+        fprintf(stderr, "Error writing ensemble metrics to %s\n", outputPath);
+    }
+    return ok;
+}
+
+/* Sample an ensemble of plans around the current plan and report where the
+   current plan falls in it; outputPath (optional) receives per-plan metrics */
+int run_ensemble(AppState* app, int plans, int burnIn, int thin, double tolerance,
+                 uint32_t seed, const char* outputPath) {
+    if (!recom_plan_ready(app)) return 0;
+    if (plans < 1) plans = 1;
+    if (burnIn < 0) burnIn = 0;
+    if (thin < 1) thin = 1;
+
+    EnsembleJob job;
+    memset(&job, 0, sizeof(job));
+    job.app = app;
+    job.numDistricts = app->currentPlan.numDistricts;
+    job.plans = plans;
+    job.burnIn = burnIn;
+    job.thin = thin;
+    job.tolerance = tolerance;
+    job.seed = seed;
+
+    int threads = cpu_count();
+    job.chains = threads * ENSEMBLE_CHAINS_PER_THREAD;
+    if (job.chains > plans) job.chains = plans;
+
+    job.results = (PlanSummary*)malloc(sizeof(PlanSummary) * plans);
+    job.steps = (long*)calloc(job.chains, sizeof(long));
+    job.accepted = (long*)calloc(job.chains, sizeof(long));
+    job.failed = (char*)calloc(job.chains, 1);
+    double* values = (double*)malloc(sizeof(double) * plans);
+    if (!job.results || !job.steps || !job.accepted || !job.failed || !values) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        free(job.results);
+        free(job.steps);
+        free(job.accepted);
+        free(job.failed);
+        free(values);
+        return 0;
+    }
+
+    printf("\n=== Ensemble Analysis ===\n");
+    printf("Plans: %d from %d ReCom chains (burn-in %d steps, recording every %d)\n",
+           plans, job.chains, burnIn, thin);
+    printf("Population tolerance ±%.1f%%, seed %u\n", tolerance * 100, seed);
+    fflush(stdout);
+
+    double started = monotonic_seconds();
+    int used = parallel_for(job.chains, threads, ensemble_task, &job);
+    double elapsed = monotonic_seconds() - started;
+
+    int ok = 1;
+    long steps = 0, accepted = 0;
+    for (int c = 0; c < job.chains; c++) {
+        if (job.failed[c]) ok = 0;
+        steps += job.steps[c];
+        accepted += job.accepted[c];
+    }
+    if (!ok) {
+        fprintf(stderr, "Memory allocation failed in an ensemble chain.\n");
+    } else {
+        printf("Sampled %d plans in %.2f s on %d thread%s (%.0f plans/s, %.1f%% of steps accepted)\n",
+               plans, elapsed, used, used == 1 ? "" : "s",
+               elapsed > 0 ? plans / elapsed : 0.0,
+               steps > 0 ? 100.0 * accepted / steps : 0.0);
+
+        PlanSummary current;
+        summarize_plan(app, app->district, &app->ledger, job.numDistricts, &current);
+        for (int m = 0; m < METRIC_COUNT; m++) {
+            for (int p = 0; p < plans; p++) {
+                values[p] = metric_value(&job.results[p], m);
+            }
+            qsort(values, plans, sizeof(double), compare_doubles);
+            print_distribution(m, values, plans, metric_value(&current, m));
+        }
+
+        if (outputPath && outputPath[0]) {
+            ok = write_ensemble_csv(&job, outputPath);
+            if (ok) printf("\nPer-plan metrics written to %s\n", outputPath);
+        }
+    }
+
+    free(job.results);
+    free(job.steps);
+    free(job.accepted);
+    free(job.failed);
+    free(values);
+    return ok;
+}
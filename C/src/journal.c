@@ -0,0 +1,513 @@
+/*
+ * US Redistricting Tool - Assignment Journal
+ *
+ * Manual edits are appended to <planId>.journal beside the saved
+ * <planId>.plan instead of rewriting the plan after every change. Each
+ * record is one move (precinct, old district, new district, time), and the
+ * editor syncs the journal to disk once per command, so a crash loses at
+ * most the command in progress. Loading a plan replays its journal on top
+ * of the plan file.
+ *
+ * Undo and redo append records as well: an undo writes the inverse move and
+ * a redo writes the move again, each tagged so that replay rebuilds both
+ * stacks. The file only grows until it is compacted.
+ *
+ * Compaction folds the journal into the plan file. Once the journal passes
+ * JOURNAL_COMPACT_RECORDS, a background thread writes a snapshot of the
+ * assignment to <planId>.plan.compact while editing carries on. When it is done
+ * the editor writes the records made since the snapshot to
+ * <planId>.journal.next, renames the new plan file into place, then renames
+ * the new journal. Each journal header names the content hash of the plan
+ * file it applies to, so after a crash at any step the journal matching
+ * the plan file on disk is the one to replay.
+ *
+ * File layout (native byte order):
+ *   JournalHeader
+ *   JournalRecord[]        a torn final record fails its check and is dropped
+ */
+
+#include "../include/maps.h"
+
+#define JOURNAL_MAGIC "PLANJNL"
+#define JOURNAL_VERSION 1
+
+/* Journal length that starts a background compaction */
+#define JOURNAL_COMPACT_RECORDS 4096
+
+typedef enum {
+    JOURNAL_EDIT = 1,
+    JOURNAL_UNDO,
+    JOURNAL_REDO
+} JournalKind;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    char planId[MAX_ID_LEN];
+    uint64_t baseHash;         /* contentHash of the plan file replayed onto */
+} JournalHeader;
+
+typedef struct {
+    uint32_t sequence;
+    uint32_t kind;             /* JournalKind */
+    int32_t precinct;
+    int32_t from;
+    int32_t to;
+    uint32_t check;            /* Hash of the other fields */
+    int64_t timestamp;
+} JournalRecord;
+
+struct JournalCompaction {
+    BackgroundTask task;
+    const AppState* app;
+    Plan plan;
+    int* district;             /* Snapshot being written */
+    uint32_t sequence;         /* First record not in the snapshot */
+    char tempPath[MAX_PATH_LEN + 8];
+    uint64_t contentHash;
+    int ok;
+};
+
+static uint32_t record_check(const JournalRecord* record) {
+    JournalRecord copy = *record;
+    copy.check = 0;
+    return (uint32_t)hash_bytes(&copy, sizeof(copy), 0);
+}
+
+static void next_path(const AssignmentJournal* j, char* out, size_t size) {
+    snprintf(out, size, "%s.next", j->path);
+}
+
+/* Journal and plan file paths of the current plan; 0 if they do not fit */
+static int set_paths(AppState* app) {
+    AssignmentJournal* j = &app->journal;
+    int baseLen = snprintf(j->basePath, sizeof(j->basePath),
+                           "%s" PATH_SEP "plans" PATH_SEP "%s" PATH_SEP "%s.plan",
+                           app->dataDir, app->currentPlan.state, app->currentPlan.planId);
+    int len = snprintf(j->path, sizeof(j->path),
+                       "%s" PATH_SEP "plans" PATH_SEP "%s" PATH_SEP "%s.journal",
+                       app->dataDir, app->currentPlan.state, app->currentPlan.planId);
+    return baseLen > 0 && baseLen < (int)sizeof(j->basePath) && len > 0 && len < (int)sizeof(j->path);
+}
+
+/* Records of a journal written for the given plan file; returns 0 if the
+   file is missing or belongs to another plan file. *torn is set when
+   trailing bytes did not form a valid record. */
+static int read_journal(const char* path, const char* planId, uint64_t baseHash,
+                        JournalRecord** records, long* count, int* torn) {
+    *records = NULL;
+    *count = 0;
+    *torn = 0;
+    FILE* file = fopen(path, "rb");
+    if (!file) return 0;
+
+    JournalHeader h;
+    int ok = fread(&h, sizeof(h), 1, file) == 1 &&
+             memcmp(h.magic, JOURNAL_MAGIC, sizeof(h.magic)) == 0 &&
+             h.version == JOURNAL_VERSION &&
+             h.recordSize == sizeof(JournalRecord) &&
+             strncmp(h.planId, planId, sizeof(h.planId)) == 0 &&
+             h.baseHash == baseHash;
+    long capacity = 0;
+    JournalRecord record;
+    size_t got;
+    while (ok && (got = fread(&record, 1, sizeof(record), file)) > 0) {
+        if (got < sizeof(record) || record.check != record_check(&record)) {
+            *torn = 1;
+            break;
+        }
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            JournalRecord* grown = (JournalRecord*)realloc(*records, sizeof(JournalRecord) * capacity);
+            if (!grown) {
+                ok = 0;
+                break;
+            }
+            *records = grown;
+        }
+        (*records)[(*count)++] = record;
+    }
+    fclose(file);
+    if (!ok) {
+        free(*records);
+        *records = NULL;
+        *count = 0;
+    }
+    return ok;
+}
+
+/* Write a complete journal file and sync it */
+static int write_journal(const char* path, const char* planId, uint64_t baseHash,
+                         const JournalRecord* records, long count) {
+    JournalHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, JOURNAL_MAGIC, sizeof(h.magic));
+    h.version = JOURNAL_VERSION;
+    h.recordSize = sizeof(JournalRecord);
+    strncpy(h.planId, planId, sizeof(h.planId) - 1);
+    h.baseHash = baseHash;
+
+    FILE* file = fopen(path, "wb");
+    if (!file) return 0;
+    int ok = fwrite(&h, sizeof(h), 1, file) == 1 &&
+             (count == 0 || fwrite(records, sizeof(JournalRecord), count, file) == (size_t)count) &&
+             sync_file(file);
+    return (fclose(file) == 0) && ok;
+}
+
+/* Replace the journal file with the given records and reopen it for appending */
+static int rewrite_journal(AssignmentJournal* j, const char* planId, uint64_t baseHash,
+                           const JournalRecord* records, long count) {
+    char nextFile[MAX_PATH_LEN + 8];
+    next_path(j, nextFile, sizeof(nextFile));
+    if (j->file) {
+        fclose(j->file);
+        j->file = NULL;
+    }
+    if (!write_journal(nextFile, planId, baseHash, records, count) || !replace_file(nextFile, j->path)) {
+        fprintf(stderr, "Could not write journal: %s\n", j->path);
+        return 0;
+    }
+    j->file = fopen(j->path, "ab");
+    if (!j->file) {
+        fprintf(stderr, "Could not open journal: %s\n", j->path);
+        return 0;
+    }
+    j->baseHash = baseHash;
+    j->recordCount = count;
+    j->pending = 0;
+    return 1;
+}
+
+static int push_move(JournalMove** stack, int* count, int* capacity, JournalMove move) {
+    if (*count == *capacity) {
+        int grown = *capacity ? *capacity * 2 : 64;
+        JournalMove* moves = (JournalMove*)realloc(*stack, sizeof(JournalMove) * grown);
+        if (!moves) return 0;
+        *stack = moves;
+        *capacity = grown;
+    }
+    (*stack)[(*count)++] = move;
+    return 1;
+}
+
+/* Apply one replayed record; returns 0 if it does not fit the assignment */
+static int replay_record(AppState* app, const JournalRecord* r) {
+    AssignmentJournal* j = &app->journal;
+    if (r->precinct < 0 || r->precinct >= app->precinctCount ||
+        r->to < 0 || r->to > app->currentPlan.numDistricts ||
+        app->district[r->precinct] != r->from) {
+        return 0;
+    }
+    assign_precinct(app, r->precinct, r->to);
+    j->nextSequence = r->sequence + 1;
+
+    /* Stacks are rebuilt as far as the journal reaches back */
+    JournalMove move = { r->precinct, r->from, r->to };
+    if (r->kind == JOURNAL_UNDO) {
+        if (j->undoCount > 0) j->undoCount--;
+        JournalMove undone = { r->precinct, r->to, r->from };
+        return push_move(&j->redo, &j->redoCount, &j->redoCapacity, undone);
+    }
+    if (r->kind == JOURNAL_REDO) {
+        if (j->redoCount > 0) j->redoCount--;
+    } else {
+        j->redoCount = 0;
+    }
+    return push_move(&j->undo, &j->undoCount, &j->undoCapacity, move);
+}
+
+static int append_record(AssignmentJournal* j, JournalKind kind, const JournalMove* move) {
+    JournalRecord record;
+    memset(&record, 0, sizeof(record));
+    record.sequence = j->nextSequence++;
+    record.kind = kind;
+    record.precinct = move->precinct;
+    record.from = move->from;
+    record.to = move->to;
+    record.timestamp = (int64_t)time(NULL);
+    record.check = record_check(&record);
+    if (fwrite(&record, sizeof(record), 1, j->file) != 1) {
+        fprintf(stderr, "Could not write journal: %s\n", j->path);
+        return 0;
+    }
+    j->recordCount++;
+    j->pending++;
+    return 1;
+}
+
+/* Open the current plan's journal, replaying any edits it holds onto the
+   plan just loaded from its plan file. With create set a new journal is
+   started if there is none; otherwise returns 0 when there is nothing to
+   replay. */
+int journal_open(AppState* app, int create) {
+    AssignmentJournal* j = &app->journal;
+    if (j->file) return 1;
+    if (!app->hasPlan || !app->currentPlan.planId[0] || !set_paths(app)) return 0;
+
+    PlanListing base;
+    if (!read_plan_info(j->basePath, &base)) {
+        if (create) fprintf(stderr, "No saved plan file to journal against: %s\n", j->basePath);
+        return 0;
+    }
+
+    /* A .next journal only matches if compaction stopped after renaming
+       the plan file; see the top of this file */
+    char nextFile[MAX_PATH_LEN + 8];
+    next_path(j, nextFile, sizeof(nextFile));
+    JournalRecord* records = NULL;
+    long count = 0;
+    int torn = 0;
+    int rewrite = 0;
+    int found = read_journal(nextFile, base.planId, base.contentHash, &records, &count, &torn);
+    if (found) {
+        rewrite = 1;
+    } else {
+        found = read_journal(j->path, base.planId, base.contentHash, &records, &count, &torn);
+        if (!found && file_exists(j->path)) {
+            fprintf(stderr, "Ignoring journal written for another version of the plan: %s\n", j->path);
+        }
+        remove(nextFile);
+    }
+    if (!found && !create) {
+        return 0;
+    }
+    if (torn) {
+        fprintf(stderr, "Dropped an incomplete record at the end of the journal.\n");
+        rewrite = 1;
+    }
+
+    j->nextSequence = 1;
+    long replayed = 0;
+    while (replayed < count && replay_record(app, &records[replayed])) {
+        replayed++;
+    }
+    if (replayed < count) {
+        fprintf(stderr, "Journal record %ld does not match the plan; ignoring the rest.\n", replayed + 1);
+        rewrite = 1;
+    }
+
+    int ok;
+    if (rewrite || !found) {
+        ok = rewrite_journal(j, base.planId, base.contentHash, records, replayed);
+    } else {
+        j->file = fopen(j->path, "ab");
+        ok = j->file != NULL;
+        j->baseHash = base.contentHash;
+        j->recordCount = replayed;
+        if (!ok) fprintf(stderr, "Could not open journal: %s\n", j->path);
+    }
+    free(records);
+    if (replayed > 0) {
+        printf("Replayed %ld journaled edit%s.\n", replayed, replayed == 1 ? "" : "s");
+    }
+    return ok;
+}
+
+/* Nonzero if a journal on disk still holds edits for the plan file */
+static int has_journaled_edits(const AssignmentJournal* j) {
+    PlanListing base;
+    if (!read_plan_info(j->basePath, &base)) return 0;
+    char nextFile[MAX_PATH_LEN + 8];
+    next_path(j, nextFile, sizeof(nextFile));
+    const char* paths[2] = { j->path, nextFile };
+    for (int p = 0; p < 2; p++) {
+        JournalRecord* records;
+        long count;
+        int torn;
+        int found = read_journal(paths[p], base.planId, base.contentHash, &records, &count, &torn);
+        free(records);
+        if (found && count > 0) return 1;
+    }
+    return 0;
+}
+
+/* Journal manual edits to the current plan. The journal only builds on a
+   saved plan that is exactly the plan in memory: a plan file holding this
+   assignment with no journaled edits on top. Otherwise returns 0, leaving
+   the files alone, so the caller can offer to save. */
+int journal_attach(AppState* app) {
+    AssignmentJournal* j = &app->journal;
+    if (j->file) return 1;
+    if (!app->hasPlan || !app->currentPlan.planId[0] || !set_paths(app)) return 0;
+    if (!plan_file_matches(app, j->basePath, app->district) || has_journaled_edits(j)) return 0;
+    return journal_open(app, 1);
+}
+
+/* Assign a precinct and journal the move */
+int journal_assign(AppState* app, int precinct, int district) {
+    AssignmentJournal* j = &app->journal;
+    JournalMove move = { precinct, app->district[precinct], district };
+    if (move.from == move.to) return 1;
+    assign_precinct(app, precinct, district);
+    if (!j->file) return 1;
+    j->redoCount = 0;
+    return append_record(j, JOURNAL_EDIT, &move) &&
+           push_move(&j->undo, &j->undoCount, &j->undoCapacity, move);
+}
+
+/* Reverse the latest journaled move; returns 0 if there is none */
+int journal_undo(AppState* app, JournalMove* move) {
+    AssignmentJournal* j = &app->journal;
+    if (!j->file || j->undoCount == 0) return 0;
+    *move = j->undo[--j->undoCount];
+    JournalMove inverse = { move->precinct, move->to, move->from };
+    assign_precinct(app, move->precinct, move->from);
+    return append_record(j, JOURNAL_UNDO, &inverse) &&
+           push_move(&j->redo, &j->redoCount, &j->redoCapacity, *move);
+}
+
+/* Repeat the latest undone move; returns 0 if there is none */
+int journal_redo(AppState* app, JournalMove* move) {
+    AssignmentJournal* j = &app->journal;
+    if (!j->file || j->redoCount == 0) return 0;
+    *move = j->redo[--j->redoCount];
+    assign_precinct(app, move->precinct, move->to);
+    return append_record(j, JOURNAL_REDO, move) &&
+           push_move(&j->undo, &j->undoCount, &j->undoCapacity, *move);
+}
+
+static void compaction_task(int task, void* ctx) {
+    (void)task;
+    JournalCompaction* c = (JournalCompaction*)ctx;
+    c->ok = write_plan_file(c->app, &c->plan, c->district, c->tempPath, &c->contentHash);
+}
+
+/* Snapshot the assignment and write it out as the new plan file in the background */
+static void start_compaction(AppState* app) {
+    AssignmentJournal* j = &app->journal;
+    JournalCompaction* c = (JournalCompaction*)calloc(1, sizeof(JournalCompaction));
+    int* district = (int*)malloc(sizeof(int) * (app->precinctCount > 0 ? app->precinctCount : 1));
+    if (!c || !district) {
+        free(c);
+        free(district);
+        return;
+    }
+    memcpy(district, app->district, sizeof(int) * app->precinctCount);
+    c->app = app;
+    c->plan = app->currentPlan;
+    c->plan.assignments = NULL;
+    get_timestamp(c->plan.lastUpdated, sizeof(c->plan.lastUpdated));
+    c->district = district;
+    c->sequence = j->nextSequence;
+    snprintf(c->tempPath, sizeof(c->tempPath), "%s.compact", j->basePath);
+    j->compaction = c;
+    background_start(&c->task, compaction_task, c);
+}
+
+/* Wait for a compaction and, if keep is set, swap in its plan file with a
+   journal of the records made since its snapshot */
+static void finish_compaction(AppState* app, int keep) {
+    AssignmentJournal* j = &app->journal;
+    JournalCompaction* c = j->compaction;
+    if (!c) return;
+    background_wait(&c->task);
+    j->compaction = NULL;
+
+    JournalRecord* records = NULL;
+    long count = 0;
+    int torn = 0;
+    int ok = keep && c->ok && sync_file(j->file) &&
+             read_journal(j->path, c->plan.planId, j->baseHash, &records, &count, &torn);
+    long first = 0;
+    while (first < count && records[first].sequence < c->sequence) {
+        first++;
+    }
+
+    char nextFile[MAX_PATH_LEN + 8];
+    next_path(j, nextFile, sizeof(nextFile));
+    if (ok) {
+        ok = write_journal(nextFile, c->plan.planId, c->contentHash,
+                           records + first, count - first);
+        if (!ok || !replace_file(c->tempPath, j->basePath)) {
+            remove(nextFile);
+            ok = 0;
+        }
+    }
+    if (ok) {
+        /* The plan file is in place; the .next journal is the one to keep */
+        fclose(j->file);
+        j->file = NULL;
+        if (replace_file(nextFile, j->path) && (j->file = fopen(j->path, "ab")) != NULL) {
+            j->baseHash = c->contentHash;
+            j->recordCount = count - first;
+            if (strcmp(app->currentPlan.planId, c->plan.planId) == 0) {
+                memcpy(app->currentPlan.lastUpdated, c->plan.lastUpdated, sizeof(c->plan.lastUpdated));
+            }
+        } else {
+            fprintf(stderr, "Could not reopen journal: %s\n", j->path);
+        }
+    } else {
+        remove(c->tempPath);
+        if (keep) fprintf(stderr, "Journal compaction failed; edits remain in %s\n", j->path);
+    }
+
+    free(records);
+    free(c->district);
+    free(c);
+}
+
+/* Sync the records written since the last sync, then collect a finished
+   compaction or start one if the journal has grown long. Called once per
+   editor command; returns 0 if edits may no longer reach the journal. */
+int journal_sync(AppState* app) {
+    AssignmentJournal* j = &app->journal;
+    if (!j->file) return 1;
+    int ok = 1;
+    if (j->pending > 0) {
+        ok = sync_file(j->file);
+        j->pending = 0;
+        if (!ok) fprintf(stderr, "Could not sync journal: %s\n", j->path);
+    }
+    if (j->compaction && background_finished(&j->compaction->task)) {
+        finish_compaction(app, 1);
+        if (!j->file) ok = 0;
+    } else if (!j->compaction && j->recordCount >= JOURNAL_COMPACT_RECORDS) {
+        start_compaction(app);
+    }
+    return ok;
+}
+
+/* Drop a running compaction before the plan file is rewritten some other way */
+void journal_cancel_compaction(AppState* app) {
+    finish_compaction(app, 0);
+}
+
+/* The plan file was just rewritten from the working plan: start an empty
+   journal on top of it, or drop stale journal files if none is open */
+int journal_rebase(AppState* app) {
+    AssignmentJournal* j = &app->journal;
+    finish_compaction(app, 0);
+    if (!j->file) {
+        if (!set_paths(app)) return 1;
+        char nextFile[MAX_PATH_LEN + 8];
+        next_path(j, nextFile, sizeof(nextFile));
+        remove(j->path);
+        remove(nextFile);
+        return 1;
+    }
+
+    PlanListing base;
+    if (!read_plan_info(j->basePath, &base)) {
+        fprintf(stderr, "Could not read plan file: %s\n", j->basePath);
+        return 0;
+    }
+    return rewrite_journal(j, base.planId, base.contentHash, NULL, 0);
+}
+
+/* Stop journaling: the journal stays on disk and is replayed with the plan.
+   Callers may already have replaced the plan in memory. */
+void journal_close(AppState* app) {
+    AssignmentJournal* j = &app->journal;
+    if (j->file) {
+        finish_compaction(app, 1);
+    }
+    if (j->file) {
+        if (!sync_file(j->file)) fprintf(stderr, "Could not sync journal: %s\n", j->path);
+        fclose(j->file);
+    }
+    free(j->undo);
+    free(j->redo);
+    memset(j, 0, sizeof(AssignmentJournal));
+}
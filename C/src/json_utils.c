@@ -68,7 +68,15 @@ static Point get_centroid_from_geometry(cJSON* geometry) {
     
     cJSON* ring = NULL;
     
-    if (strcmp(type->valuestring, "Polygon") == 0) {
+    if (strcmp(type->valuestring, "Point") == 0) {
+        cJSON* x = cJSON_GetArrayItem(coordinates, 0);
+        cJSON* y = cJSON_GetArrayItem(coordinates, 1);
+        if (x && y) {
+            centroid.x = x->valuedouble;
+            centroid.y = y->valuedouble;
+        }
+        return centroid;
+    } else if (strcmp(type->valuestring, "Polygon") == 0) {
         ring = cJSON_GetArrayItem(coordinates, 0);
     } else if (strcmp(type->valuestring, "MultiPolygon") == 0) {
         cJSON* firstPoly = cJSON_GetArrayItem(coordinates, 0);
@@ -103,160 +111,574 @@ static Point get_centroid_from_geometry(cJSON* geometry) {
     return centroid;
 }
 
-/* Parse GeoJSON FeatureCollection and populate precincts */
-int parse_geojson(AppState* app, const char* jsonStr) {
-    cJSON* root = cJSON_Parse(jsonStr);
-    if (!root) {
-        fprintf(stderr, "Error parsing GeoJSON\n");
-        return 0;
+/*
+ * Streaming GeoJSON reader
+ *
+ * The FeatureCollection is walked once straight from disk. Top-level members
+ * other than "type" and "features" are skipped without being buffered, and
+ * each element of "features" is copied into a reusable text buffer and parsed
+ * on its own with cJSON, handed to a callback, then freed before the next
+ * feature is read.
+ *
+ * Parsing therefore never holds more than one feature: roughly
+ * GEOJSON_READ_CHUNK + F + ~10 * F bytes, where F is the text size of the
+ * biggest feature (the factor covers cJSON's node overhead for coordinate
+ * arrays). What does grow with the file is the output: the precinct records
+ * and the TopologyBuilder's vertex, edge and neighbor pair tables, which are
+ * proportional to the number of distinct coordinates and ring edges in the
+ * whole state. The builder is freed once the adjacency graph is built.
+ */
+
+#define GEOJSON_READ_CHUNK (64 * 1024)
+#define GEOJSON_MAX_KEY_LEN 64
+
+typedef struct {
+    FILE* file;
+    char buffer[GEOJSON_READ_CHUNK];
+    size_t length;
+    size_t pos;
+    long line;
+
+    /* Capture buffer for the feature currently being read */
+    char* text;
+    size_t textLen;
+    size_t textCap;
+    int capturing;
+} GeoReader;
+
+/* Called once per feature; return 0 to stop reading */
+typedef int (*GeoFeatureHandler)(cJSON* feature, void* ctx);
+
+static int reader_fill(GeoReader* r) {
+    r->length = fread(r->buffer, 1, sizeof(r->buffer), r->file);
+    r->pos = 0;
+    return r->length > 0;
+}
+
+static int reader_append(GeoReader* r, char c) {
+    if (r->textLen + 1 >= r->textCap) {
+        size_t newCap = r->textCap ? r->textCap * 2 : 4096;
+        char* grown = (char*)realloc(r->text, newCap);
+        if (!grown) return 0;
+        r->text = grown;
+        r->textCap = newCap;
     }
-    
-    cJSON* type = cJSON_GetObjectItem(root, "type");
-    if (!type || !cJSON_IsString(type) || strcmp(type->valuestring, "FeatureCollection") != 0) {
-        fprintf(stderr, "Invalid GeoJSON: not a FeatureCollection\n");
-        cJSON_Delete(root);
+    r->text[r->textLen++] = c;
+    return 1;
+}
+
+/* Return next character, or -1 at end of file */
+static int reader_next(GeoReader* r) {
+    if (r->pos >= r->length && !reader_fill(r)) return -1;
+    char c = r->buffer[r->pos++];
+    if (c == '\n') r->line++;
+    if (r->capturing && !reader_append(r, c)) return -1;
+    return (unsigned char)c;
+}
+
+static int reader_peek(GeoReader* r) {
+    if (r->pos >= r->length && !reader_fill(r)) return -1;
+    return (unsigned char)r->buffer[r->pos];
+}
+
+static int reader_skip_ws(GeoReader* r) {
+    int c;
+    while ((c = reader_peek(r)) == ' ' || c == '\t' || c == '\n' || c == '\r') {
+        reader_next(r);
+    }
+    return c;
+}
+
+/* Consume a string body after the opening quote; copies up to outSize-1 bytes */
+static int reader_string(GeoReader* r, char* out, size_t outSize) {
+    size_t n = 0;
+    int c;
+    while ((c = reader_next(r)) != -1) {
+        if (c == '"') {
+            if (out) out[n] = '\0';
+            return 1;
+        }
+        if (c == '\\') {
+            c = reader_next(r);
+            if (c == -1) return 0;
+        }
+        if (out && n + 1 < outSize) out[n++] = (char)c;
+    }
+    return 0;
+}
+
+/* Consume one JSON value of any type (copied to r->text if capturing) */
+static int reader_value(GeoReader* r) {
+    int c = reader_skip_ws(r);
+    if (c == -1) return 0;
+
+    if (c == '"') {
+        reader_next(r);
+        return reader_string(r, NULL, 0);
+    }
+
+    if (c == '{' || c == '[') {
+        int depth = 0;
+        while ((c = reader_next(r)) != -1) {
+            if (c == '"') {
+                if (!reader_string(r, NULL, 0)) return 0;
+            } else if (c == '{' || c == '[') {
+                depth++;
+            } else if (c == '}' || c == ']') {
+                if (--depth == 0) return 1;
+            }
+        }
         return 0;
     }
-    
-    cJSON* features = cJSON_GetObjectItem(root, "features");
-    if (!features || !cJSON_IsArray(features)) {
-        fprintf(stderr, "Invalid GeoJSON: no features array\n");
-        cJSON_Delete(root);
+
+    /* Scalar: number, true, false, null */
+    while ((c = reader_peek(r)) != -1 && c != ',' && c != '}' && c != ']' &&
+           c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+        reader_next(r);
+    }
+    return 1;
+}
+
+/* Walk the "features" array, parsing and dispatching one feature at a time */
+static int reader_features(GeoReader* r, GeoFeatureHandler handler, void* ctx) {
+    if (reader_skip_ws(r) != '[') {
+        fprintf(stderr, "Invalid GeoJSON: features is not an array (line %ld)\n", r->line);
         return 0;
     }
-    
-    app->precinctCount = 0;
-    int index = 0;
-    
-    cJSON* feature;
-    cJSON_ArrayForEach(feature, features) {
-        if (app->precinctCount >= MAX_PRECINCTS) break;
-        
-        Precinct* p = &app->precincts[app->precinctCount];
-        memset(p, 0, sizeof(Precinct));
-        
-        p->index = index++;
-        p->district = 0; /* Unassigned */
-        
-        cJSON* properties = cJSON_GetObjectItem(feature, "properties");
-        cJSON* geometry = cJSON_GetObjectItem(feature, "geometry");
-        
-        if (properties) {
-            /* Get precinct ID */
-            cJSON* id = cJSON_GetObjectItem(properties, "id");
-            if (!id) id = cJSON_GetObjectItem(properties, "precinct_id");
-            if (!id) id = cJSON_GetObjectItem(properties, "GEOID20");
-            if (!id) id = cJSON_GetObjectItem(properties, "UNIQUE_ID");
-            
-            if (id) {
-                if (cJSON_IsString(id)) {
-                    strncpy(p->id, id->valuestring, sizeof(p->id) - 1);
-                } else if (cJSON_IsNumber(id)) {
-                    snprintf(p->id, sizeof(p->id), "%d", id->valueint);
-                }
-            } else {
-                snprintf(p->id, sizeof(p->id), "p_%d", p->index);
-            }
-            
-            /* Get population */
-            cJSON* pop = cJSON_GetObjectItem(properties, "population");
-            if (!pop) pop = cJSON_GetObjectItem(properties, "TOTPOP");
-            if (!pop) pop = cJSON_GetObjectItem(properties, "POP100");
-            if (pop && cJSON_IsNumber(pop)) {
-                p->population = (int)pop->valuedouble;
+    reader_next(r);
+
+    if (reader_skip_ws(r) == ']') {
+        reader_next(r);
+        return 1;
+    }
+
+    int keepGoing = 1;
+    while (1) {
+        if (keepGoing) {
+            reader_skip_ws(r);
+            r->textLen = 0;
+            r->capturing = 1;
+            int ok = reader_value(r);
+            r->capturing = 0;
+            if (!ok) {
+                fprintf(stderr, "Invalid GeoJSON: truncated feature (line %ld)\n", r->line);
+                return 0;
             }
-            
-            /* Get dem votes */
-            cJSON* dem = cJSON_GetObjectItem(properties, "dem");
-            if (!dem) dem = cJSON_GetObjectItem(properties, "dem_votes");
-            if (!dem) dem = cJSON_GetObjectItem(properties, "G20PREDBID");
-            if (dem && cJSON_IsNumber(dem)) {
-                p->dem = (int)dem->valuedouble;
+
+            cJSON* feature = cJSON_ParseWithLength(r->text, r->textLen);
+            if (!feature) {
+                fprintf(stderr, "Error parsing GeoJSON feature ending at line %ld\n", r->line);
+                return 0;
             }
-            
-            /* Get rep votes */
-            cJSON* rep = cJSON_GetObjectItem(properties, "rep");
-            if (!rep) rep = cJSON_GetObjectItem(properties, "rep_votes");
-            if (!rep) rep = cJSON_GetObjectItem(properties, "G20PRERTRU");
-            if (rep && cJSON_IsNumber(rep)) {
-                p->rep = (int)rep->valuedouble;
+            keepGoing = handler(feature, ctx);
+            cJSON_Delete(feature);
+        } else if (!reader_value(r)) {
+            return 0;
+        }
+
+        int c = reader_skip_ws(r);
+        reader_next(r);
+        if (c == ']') return 1;
+        if (c != ',') {
+            fprintf(stderr, "Invalid GeoJSON: expected ',' or ']' in features (line %ld)\n", r->line);
+            return 0;
+        }
+    }
+}
+
+/* Stream a GeoJSON FeatureCollection from disk, calling handler per feature */
+static int stream_geojson_features(const char* path, GeoFeatureHandler handler, void* ctx) {
+    GeoReader* r = (GeoReader*)calloc(1, sizeof(GeoReader));
+    if (!r) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        return 0;
+    }
+
+    r->file = fopen(path, "rb");
+    if (!r->file) {
+        free(r);
+        return 0;
+    }
+    r->line = 1;
+
+    int ok = 1;
+    int sawFeatures = 0;
+    char typeName[GEOJSON_MAX_KEY_LEN] = {0};
+
+    if (reader_skip_ws(r) != '{') {
+        fprintf(stderr, "Error parsing GeoJSON: expected an object\n");
+        ok = 0;
+    } else {
+        reader_next(r);
+    }
+
+    while (ok) {
+        int c = reader_skip_ws(r);
+        if (c == '}') break;
+        if (c == ',') {
+            reader_next(r);
+            continue;
+        }
+        if (c != '"') {
+            fprintf(stderr, "Error parsing GeoJSON at line %ld\n", r->line);
+            ok = 0;
+            break;
+        }
+
+        char key[GEOJSON_MAX_KEY_LEN];
+        reader_next(r);
+        if (!reader_string(r, key, sizeof(key)) || reader_skip_ws(r) != ':') {
+            fprintf(stderr, "Error parsing GeoJSON at line %ld\n", r->line);
+            ok = 0;
+            break;
+        }
+        reader_next(r);
+
+        if (strcmp(key, "type") == 0 && reader_skip_ws(r) == '"') {
+            reader_next(r);
+            ok = reader_string(r, typeName, sizeof(typeName));
+        } else if (strcmp(key, "features") == 0) {
+            sawFeatures = 1;
+            ok = reader_features(r, handler, ctx);
+        } else {
+            ok = reader_value(r);
+        }
+    }
+
+    if (ok && strcmp(typeName, "FeatureCollection") != 0) {
+        fprintf(stderr, "Invalid GeoJSON: not a FeatureCollection\n");
+        ok = 0;
+    } else if (ok && !sawFeatures) {
+        fprintf(stderr, "Invalid GeoJSON: no features array\n");
+        ok = 0;
+    }
+
+    fclose(r->file);
+    free(r->text);
+    free(r);
+    return ok;
+}
+
+/* State shared by the per-feature callback during a GeoJSON load */
+typedef struct {
+    AppState* app;
+    TopologyBuilder* topology;
+    double* ring;       /* Scratch buffer of interleaved x,y coordinates */
+    int ringCap;
+    int ringsAdded;
+    int failed;
+} GeoLoadContext;
+
+/* Feed one polygon ring of a feature to the topology builder and its bounds */
+static int add_geometry_ring(GeoLoadContext* ctx, Precinct* p, cJSON* ring) {
+    int n = cJSON_GetArraySize(ring);
+    if (n < 2) return 1;
+
+    if (n > ctx->ringCap) {
+        double* grown = (double*)realloc(ctx->ring, sizeof(double) * 2 * n);
+        if (!grown) return 0;
+        ctx->ring = grown;
+        ctx->ringCap = n;
+    }
+
+    int count = 0;
+    cJSON* coord;
+    cJSON_ArrayForEach(coord, ring) {
+        cJSON* x = cJSON_GetArrayItem(coord, 0);
+        cJSON* y = cJSON_GetArrayItem(coord, 1);
+        if (x && y && cJSON_IsNumber(x) && cJSON_IsNumber(y)) {
+            ctx->ring[2 * count] = x->valuedouble;
+            ctx->ring[2 * count + 1] = y->valuedouble;
+            count++;
+
+            if (x->valuedouble < p->bounds.minX) p->bounds.minX = x->valuedouble;
+            if (x->valuedouble > p->bounds.maxX) p->bounds.maxX = x->valuedouble;
+            if (y->valuedouble < p->bounds.minY) p->bounds.minY = y->valuedouble;
+            if (y->valuedouble > p->bounds.maxY) p->bounds.maxY = y->valuedouble;
+        }
+    }
+
+    ctx->ringsAdded++;
+    return topology_add_ring(ctx->topology, p->index, ctx->ring, count);
+}
+
+/* Feed every ring (outer and holes) of a Polygon or MultiPolygon */
+static int add_geometry_topology(GeoLoadContext* ctx, Precinct* p, cJSON* geometry) {
+    if (!geometry) return 1;
+
+    cJSON* type = cJSON_GetObjectItem(geometry, "type");
+    cJSON* coordinates = cJSON_GetObjectItem(geometry, "coordinates");
+    if (!type || !cJSON_IsString(type) || !coordinates) return 1;
+
+    cJSON* polygon;
+    cJSON* ring;
+    if (strcmp(type->valuestring, "Polygon") == 0) {
+        cJSON_ArrayForEach(ring, coordinates) {
+            if (!add_geometry_ring(ctx, p, ring)) return 0;
+        }
+    } else if (strcmp(type->valuestring, "MultiPolygon") == 0) {
+        cJSON_ArrayForEach(polygon, coordinates) {
+            cJSON_ArrayForEach(ring, polygon) {
+                if (!add_geometry_ring(ctx, p, ring)) return 0;
             }
-            
-            /* Get county */
-            cJSON* county = cJSON_GetObjectItem(properties, "county");
-            if (!county) county = cJSON_GetObjectItem(properties, "COUNTY");
-            if (!county) county = cJSON_GetObjectItem(properties, "COUNTYFP");
-            if (!county) county = cJSON_GetObjectItem(properties, "COUNTYFP20");
-            
-            if (county && cJSON_IsString(county)) {
-                strncpy(p->county, county->valuestring, sizeof(p->county) - 1);
-            } else {
-                strcpy(p->county, "unknown");
+        }
+    }
+    return 1;
+}
+
+/* Copy one feature's properties and centroid into the next precinct slot */
+static int add_precinct_feature(cJSON* feature, void* userData) {
+    GeoLoadContext* ctx = (GeoLoadContext*)userData;
+    AppState* app = ctx->app;
+    if (app->precinctCount >= app->precinctCapacity &&
+        !reserve_precincts(app, app->precinctCapacity ? app->precinctCapacity * 2 : 1024)) {
+        ctx->failed = 1;
+        return 0;
+    }
+
+    int idx = app->precinctCount;
+    Precinct* p = &app->precincts[idx];
+    memset(p, 0, sizeof(Precinct));
+
+    p->index = idx;
+    app->population[idx] = 0;
+    app->dem[idx] = 0;
+    app->rep[idx] = 0;
+    app->district[idx] = 0; /* Unassigned */
+
+    cJSON* properties = cJSON_GetObjectItem(feature, "properties");
+    cJSON* geometry = cJSON_GetObjectItem(feature, "geometry");
+    const char* countyName = "unknown";
+
+    if (properties) {
+        /* Get precinct ID */
+        cJSON* id = cJSON_GetObjectItem(properties, "id");
+        if (!id) id = cJSON_GetObjectItem(properties, "precinct_id");
+        if (!id) id = cJSON_GetObjectItem(properties, "GEOID20");
+        if (!id) id = cJSON_GetObjectItem(properties, "UNIQUE_ID");
+
+        if (id) {
+            if (cJSON_IsString(id)) {
+                strncpy(p->id, id->valuestring, sizeof(p->id) - 1);
+            } else if (cJSON_IsNumber(id)) {
+                snprintf(p->id, sizeof(p->id), "%d", id->valueint);
             }
+        } else {
+            snprintf(p->id, sizeof(p->id), "p_%d", p->index);
         }
-        
-        /* Calculate dem share */
-        int totalVotes = p->dem + p->rep;
-        p->demShare = totalVotes > 0 ? (double)p->dem / totalVotes : 0.5;
-        
-        /* Get centroid */
-        p->centroid = get_centroid_from_geometry(geometry);
-        
-        app->precinctCount++;
+
+        /* Get population */
+        cJSON* pop = cJSON_GetObjectItem(properties, "population");
+        if (!pop) pop = cJSON_GetObjectItem(properties, "TOTPOP");
+        if (!pop) pop = cJSON_GetObjectItem(properties, "POP100");
+        if (pop && cJSON_IsNumber(pop)) {
+            app->population[idx] = (int)pop->valuedouble;
+        }
+
+        /* Get dem votes */
+        cJSON* dem = cJSON_GetObjectItem(properties, "dem");
+        if (!dem) dem = cJSON_GetObjectItem(properties, "dem_votes");
+        if (!dem) dem = cJSON_GetObjectItem(properties, "G20PREDBID");
+        if (dem && cJSON_IsNumber(dem)) {
+            app->dem[idx] = (int)dem->valuedouble;
+        }
+
+        /* Get rep votes */
+        cJSON* rep = cJSON_GetObjectItem(properties, "rep");
+        if (!rep) rep = cJSON_GetObjectItem(properties, "rep_votes");
+        if (!rep) rep = cJSON_GetObjectItem(properties, "G20PRERTRU");
+        if (rep && cJSON_IsNumber(rep)) {
+            app->rep[idx] = (int)rep->valuedouble;
+        }
+
+        /* Get county */
+        cJSON* county = cJSON_GetObjectItem(properties, "county");
+        if (!county) county = cJSON_GetObjectItem(properties, "COUNTY");
+        if (!county) county = cJSON_GetObjectItem(properties, "COUNTYFP");
+        if (!county) county = cJSON_GetObjectItem(properties, "COUNTYFP20");
+
+        countyName = county && cJSON_IsString(county) ? county->valuestring : "unknown";
     }
-    
-    cJSON_Delete(root);
-    
-    /* Build adjacency graph based on proximity */
+
+    app->countyId[idx] = intern_county(&app->counties, countyName);
+    if (app->countyId[idx] < 0) {
+        fprintf(stderr, "Out of memory interning county names.\n");
+        ctx->failed = 1;
+        return 0;
+    }
+
+    /* Calculate dem share */
+    int totalVotes = app->dem[idx] + app->rep[idx];
+    p->demShare = totalVotes > 0 ? (double)app->dem[idx] / totalVotes : 0.5;
+
+    /* Get centroid */
+    p->centroid = get_centroid_from_geometry(geometry);
+
+    p->bounds.minX = p->bounds.minY = 1e300;
+    p->bounds.maxX = p->bounds.maxY = -1e300;
+    if (!add_geometry_topology(ctx, p, geometry)) {
+        fprintf(stderr, "Out of memory building precinct adjacency.\n");
+        ctx->failed = 1;
+        return 0;
+    }
+    if (p->bounds.minX > p->bounds.maxX) {
+        p->bounds.minX = p->bounds.maxX = p->centroid.x;
+        p->bounds.minY = p->bounds.maxY = p->centroid.y;
+    }
+
+    app->precinctCount++;
+    return 1;
+}
+
+/* Fallback for files without polygons: link precincts with nearby centroids */
+static int build_proximity_adjacency(AppState* app, AdjacencyGraph* graph) {
     double threshold = 0.01;
-    for (int i = 0; i < app->precinctCount; i++) {
-        app->precincts[i].neighborCount = 0;
-        for (int j = 0; j < app->precinctCount; j++) {
-            if (i == j) continue;
-            if (app->precincts[i].neighborCount >= MAX_NEIGHBORS) break;
-            
-            double dx = app->precincts[i].centroid.x - app->precincts[j].centroid.x;
-            double dy = app->precincts[i].centroid.y - app->precincts[j].centroid.y;
-            double dist = sqrt(dx * dx + dy * dy);
-            
-            /* Consider adjacent if close enough or same county */
-            if (dist < threshold || strcmp(app->precincts[i].county, app->precincts[j].county) == 0) {
-                app->precincts[i].neighbors[app->precincts[i].neighborCount++] = j;
+    int n = app->precinctCount;
+
+    memset(graph, 0, sizeof(AdjacencyGraph));
+    SpatialIndex idx;
+    memset(&idx, 0, sizeof(idx));
+    if (!build_spatial_index(&idx, app)) return 0;
+
+    int* found = (int*)malloc(sizeof(int) * (n > 0 ? n : 1));
+    graph->offsets = (int*)calloc(n + 1, sizeof(int));
+    if (!found || !graph->offsets) {
+        free(found);
+        free_spatial_index(&idx);
+        free_adjacency_graph(graph);
+        return 0;
+    }
+
+    /* Count first, then fill */
+    for (int pass = 0; pass < 2; pass++) {
+        int out = 0;
+        for (int i = 0; i < n; i++) {
+            graph->offsets[i] = out;
+            int count = spatial_query_radius(&idx, app, app->precincts[i].centroid.x,
+                                             app->precincts[i].centroid.y, threshold, found, n);
+            for (int k = 0; k < count; k++) {
+                if (found[k] == i) continue;
+                if (pass == 1) graph->neighbors[out] = found[k];
+                out++;
+            }
+        }
+        graph->offsets[n] = out;
+
+        if (pass == 0) {
+            graph->neighbors = (int*)malloc(sizeof(int) * (out > 0 ? out : 1));
+            if (!graph->neighbors) {
+                free(found);
+                free_spatial_index(&idx);
+                free_adjacency_graph(graph);
+                return 0;
             }
         }
     }
-    
+
+    free(found);
+    free_spatial_index(&idx);
+    graph->nodeCount = n;
+    graph->edgeCount = graph->offsets[n];
     return 1;
 }
 
-/* Create JSON string for saving a plan */
-char* create_plan_json(AppState* app) {
-    cJSON* root = cJSON_CreateObject();
-    
-    cJSON_AddStringToObject(root, "state", app->currentPlan.state);
-    cJSON_AddStringToObject(root, "planId", app->currentPlan.planId);
-    cJSON_AddStringToObject(root, "name", app->currentPlan.name);
-    cJSON_AddNumberToObject(root, "numDistricts", app->currentPlan.numDistricts);
-    
+/* Stream a GeoJSON FeatureCollection file and populate precincts */
+int parse_geojson_file(AppState* app, const char* path) {
+    GeoLoadContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.app = app;
+    ctx.topology = topology_create(app->adjacencyMode, 1);
+    if (!ctx.topology) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        return 0;
+    }
+
+    app->precinctCount = 0;
+    free_county_table(&app->counties);
+    free_adjacency_graph(&app->adjacency);
+
+    int ok = stream_geojson_features(path, add_precinct_feature, &ctx) && !ctx.failed;
+
+    if (ok) {
+        if (ctx.ringsAdded > 0) {
+            ok = topology_build(ctx.topology, app->precinctCount, &app->adjacency);
+        } else {
+            ok = build_proximity_adjacency(app, &app->adjacency);
+        }
+        if (!ok) {
+            fprintf(stderr, "Out of memory building precinct adjacency.\n");
+        }
+    }
+
+    topology_free(ctx.topology);
+    free(ctx.ring);
+
+    /* Give back the slack left by geometric growth */
+    if (ok && app->precinctCount > 0 && app->precinctCount < app->precinctCapacity) {
+        Precinct* fitted = (Precinct*)realloc(app->precincts, sizeof(Precinct) * app->precinctCount);
+        if (fitted) {
+            app->precincts = fitted;
+            app->precinctCapacity = app->precinctCount;
+            int** columns[] = { &app->population, &app->dem, &app->rep, &app->district, &app->countyId };
+            for (size_t c = 0; c < sizeof(columns) / sizeof(columns[0]); c++) {
+                int* col = (int*)realloc(*columns[c], sizeof(int) * app->precinctCount);
+                if (col) *columns[c] = col;
+            }
+        }
+    }
+    return ok;
+}
+
+/* Write a string as a JSON string literal */
+static int write_json_string(FILE* out, const char* str) {
+    if (fputc('"', out) == EOF) return 0;
+    for (const unsigned char* c = (const unsigned char*)str; *c; c++) {
+        int ok;
+        switch (*c) {
+            case '"': ok = fputs("\\\"", out) >= 0; break;
+            case '\\': ok = fputs("\\\\", out) >= 0; break;
+            case '\n': ok = fputs("\\n", out) >= 0; break;
+            case '\r': ok = fputs("\\r", out) >= 0; break;
+            case '\t': ok = fputs("\\t", out) >= 0; break;
+            default:
+                ok = *c < 0x20 ? fprintf(out, "\\u%04x", *c) > 0 : fputc(*c, out) != EOF;
+                break;
+        }
+        if (!ok) return 0;
+    }
+    return fputc('"', out) != EOF;
+}
+
+/* Stream the current plan as JSON keyed by precinct id, laid out as
+   cJSON_Print would. Assignments go straight from district[] to the
+   stream, so memory use does not depend on the precinct count. */
+int write_plan_json(AppState* app, FILE* out) {
     char timestamp[32];
     get_timestamp(timestamp, sizeof(timestamp));
-    cJSON_AddStringToObject(root, "lastUpdated", timestamp);
     
-    /* Create assignments object */
-    cJSON* assignments = cJSON_CreateObject();
-    for (int i = 0; i < app->precinctCount; i++) {
-        if (app->precincts[i].district > 0) {
-            char value[16];
-            snprintf(value, sizeof(value), "%d", app->precincts[i].district);
-            cJSON_AddNumberToObject(assignments, app->precincts[i].id, app->precincts[i].district);
+    int ok = fputs("{\n\t\"state\":\t", out) >= 0 &&
+             write_json_string(out, app->currentPlan.state) &&
+             fputs(",\n\t\"planId\":\t", out) >= 0 &&
+             write_json_string(out, app->currentPlan.planId) &&
+             fputs(",\n\t\"name\":\t", out) >= 0 &&
+             write_json_string(out, app->currentPlan.name) &&
+             fprintf(out, ",\n\t\"numDistricts\":\t%d,\n\t\"lastUpdated\":\t",
+                     app->currentPlan.numDistricts) > 0 &&
+             write_json_string(out, timestamp) &&
+             fputs(",\n\t\"assignments\":\t{", out) >= 0;
+    
+    const char* separator = "\n";
+    for (int i = 0; ok && i < app->precinctCount; i++) {
+        if (app->district[i] > 0) {
+            ok = fputs(separator, out) >= 0 &&
+                 fputs("\t\t", out) >= 0 &&
+                 write_json_string(out, app->precincts[i].id) &&
+                 fprintf(out, ":\t%d", app->district[i]) > 0;
+            separator = ",\n";
         }
     }
-    cJSON_AddItemToObject(root, "assignments", assignments);
     
-    char* jsonStr = cJSON_Print(root);
-    cJSON_Delete(root);
-    
-    return jsonStr;
+    return ok && fputs("\n\t}\n}", out) >= 0;
 }
 
 /* Parse plan JSON and load assignments */
@@ -291,7 +713,7 @@ int parse_plan_json(AppState* app, const char* jsonStr) {
     
     /* Reset all district assignments */
     for (int i = 0; i < app->precinctCount; i++) {
-        app->precincts[i].district = 0;
+        app->district[i] = 0;
     }
     
     /* Load assignments */
@@ -306,16 +728,14 @@ int parse_plan_json(AppState* app, const char* jsonStr) {
             }
             
             /* Find precinct by ID and assign district */
-            for (int i = 0; i < app->precinctCount; i++) {
-                if (strcmp(app->precincts[i].id, precinctId) == 0) {
-                    app->precincts[i].district = districtId;
-                    break;
-                }
+            int i = find_precinct(app, precinctId);
+            if (i >= 0) {
+                app->district[i] = districtId;
             }
         }
     }
     
     app->hasPlan = 1;
     cJSON_Delete(root);
-    return 1;
+    return sync_ledger(app);
 }
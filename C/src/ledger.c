@@ -0,0 +1,110 @@
+/*
+ * US Redistricting Tool - District Ledger
+ *
+ * Per-district population, vote and precinct totals plus per-county
+ * membership counts. The ledger is rebuilt with one pass over an assignment
+ * array and then updated in O(1) per precinct move, so automap and the
+ * metrics views never rescan every precinct to get district totals.
+ *
+ * The ledger only reads the assignment array it was built from; callers
+ * that keep their own array (for example a worker thread) pass it in and
+ * report each move with ledger_move.
+ */
+
+#include "../include/maps.h"
+
+/* Ledger slot for a district id */
+static int ledger_slot(int district) {
+    return district >= 1 && district <= MAX_DISTRICTS ? district : 0;
+}
+
+/* Recompute every total from an assignment array */
+int ledger_rebuild(DistrictLedger* ledger, const AppState* app, const int* district) {
+    int countyTotal = app->counties.count;
+    size_t memberCount = (size_t)(MAX_DISTRICTS + 1) * (countyTotal > 0 ? countyTotal : 1);
+    
+    if (!ledger->countyMembers || ledger->countyTotal != countyTotal) {
+        int* members = (int*)realloc(ledger->countyMembers, sizeof(int) * memberCount);
+        if (!members) {
+            fprintf(stderr, "Out of memory allocating district ledger.\n");
+            return 0;
+        }
+        ledger->countyMembers = members;
+        ledger->countyTotal = countyTotal;
+    }
+    
+    memset(ledger->population, 0, sizeof(ledger->population));
+    memset(ledger->dem, 0, sizeof(ledger->dem));
+    memset(ledger->rep, 0, sizeof(ledger->rep));
+    memset(ledger->precinctCount, 0, sizeof(ledger->precinctCount));
+    memset(ledger->countyCount, 0, sizeof(ledger->countyCount));
+    memset(ledger->countyMembers, 0, sizeof(int) * memberCount);
+    
+    for (int i = 0; i < app->precinctCount; i++) {
+        int d = ledger_slot(district[i]);
+        ledger->population[d] += app->population[i];
+        ledger->dem[d] += app->dem[i];
+        ledger->rep[d] += app->rep[i];
+        ledger->precinctCount[d]++;
+        if (ledger->countyMembers[d * countyTotal + app->countyId[i]]++ == 0) {
+            ledger->countyCount[d]++;
+        }
+    }
+    return 1;
+}
+
+void ledger_free(DistrictLedger* ledger) {
+    free(ledger->countyMembers);
+    memset(ledger, 0, sizeof(DistrictLedger));
+}
+
+/* Account for one precinct moving between districts */
+void ledger_move(DistrictLedger* ledger, const AppState* app, int precinct, int from, int to) {
+    from = ledger_slot(from);
+    to = ledger_slot(to);
+    if (from == to) return;
+    
+    int pop = app->population[precinct];
+    int dem = app->dem[precinct];
+    int rep = app->rep[precinct];
+    int county = app->countyId[precinct];
+    
+    ledger->population[from] -= pop;
+    ledger->dem[from] -= dem;
+    ledger->rep[from] -= rep;
+    ledger->precinctCount[from]--;
+    if (--ledger->countyMembers[from * ledger->countyTotal + county] == 0) {
+        ledger->countyCount[from]--;
+    }
+    
+    ledger->population[to] += pop;
+    ledger->dem[to] += dem;
+    ledger->rep[to] += rep;
+    ledger->precinctCount[to]++;
+    if (ledger->countyMembers[to * ledger->countyTotal + county]++ == 0) {
+        ledger->countyCount[to]++;
+    }
+}
+
+/* Assign a precinct in the working plan and keep the ledger in step */
+void assign_precinct(AppState* app, int precinct, int district) {
+    ledger_move(&app->ledger, app, precinct, app->district[precinct], district);
+    contiguity_moved(&app->contiguity, app->district[precinct], district);
+    app->district[precinct] = district;
+}
+
+/* Unassign every precinct */
+int clear_assignments(AppState* app) {
+    for (int i = 0; i < app->precinctCount; i++) {
+        app->district[i] = 0;
+    }
+    return sync_ledger(app);
+}
+
+/* Rebuild the ledger and contiguity caches after district[] was written
+   directly; the assignment no longer follows the edit journal */
+int sync_ledger(AppState* app) {
+    journal_close(app);
+    return ledger_rebuild(&app->ledger, app, app->district) &&
+           contiguity_init(&app->contiguity, app);
+}
@@ -13,6 +13,8 @@
  */
 
 #include "../include/maps.h"
+#include <errno.h>
+#include <limits.h>
 
 /* External UI functions */
 extern void show_help(void);
@@ -95,7 +97,7 @@ static void handle_plan_menu(AppState* app) {
     
     while (1) {
         show_plan_menu(app);
-        choice = get_user_choice(0, 5);
+        choice = get_user_choice(0, 8);
         
         switch (choice) {
             case 0:
@@ -154,6 +156,44 @@ static void handle_plan_menu(AppState* app) {
                 getchar();
                 break;
                 
+            case 6:
+                if (app->hasPlan) {
+                    get_user_string("Export to file (e.g., plan.json): ", input, sizeof(input));
+                    if (input[0] && export_plan_json(app, input)) {
+                        printf("Plan exported to: %s\n", input);
+                    }
+                } else {
+                    printf("No plan loaded.\n");
+                }
+                printf("Press Enter to continue...");
+                getchar();
+                break;
+                
+            case 7:
+                if (!app->currentState) {
+                    printf("Please load a state first.\n");
+                } else {
+                    get_user_string("Import from file: ", input, sizeof(input));
+                    if (input[0] && import_plan_json(app, input)) {
+                        printf("Imported plan: %s\n", app->currentPlan.name);
+                        printf("Save it to keep a binary copy in the plans directory.\n");
+                    }
+                }
+                printf("Press Enter to continue...");
+                getchar();
+                break;
+                
+            case 8:
+                if (!app->currentState) {
+                    printf("Please load a state first.\n");
+                } else {
+                    refresh_plan_manifest(app, app->currentState->abbr, 1);
+                    printf("Indexed %d plan files.\n", app->planCount);
+                }
+                printf("Press Enter to continue...");
+                getchar();
+                break;
+                
             default:
                 break;
         }
@@ -195,9 +235,7 @@ static void handle_district_settings(AppState* app) {
                 
             case 2:
                 printf("Clearing all district assignments...\n");
-                for (int i = 0; i < app->precinctCount; i++) {
-                    app->precincts[i].district = 0;
-                }
+                clear_assignments(app);
                 printf("All precincts unassigned.\n");
                 printf("Press Enter to continue...");
                 getchar();
@@ -213,14 +251,9 @@ static void handle_district_settings(AppState* app) {
                            "--------", "----------", "-------", "-------", "-----");
                     
                     for (int d = 1; d <= numDist; d++) {
-                        int pop = 0, dem = 0, rep = 0;
-                        for (int i = 0; i < app->precinctCount; i++) {
-                            if (app->precincts[i].district == d) {
-                                pop += app->precincts[i].population;
-                                dem += app->precincts[i].dem;
-                                rep += app->precincts[i].rep;
-                            }
-                        }
+                        int pop = app->ledger.population[d];
+                        int dem = app->ledger.dem[d];
+                        int rep = app->ledger.rep[d];
                         double demShare = (dem + rep) > 0 ? 100.0 * dem / (dem + rep) : 0;
                         printf("%-10d %-12d %-10d %-10d %-7.1f%%\n", 
                                d, pop, dem, rep, demShare);
@@ -238,6 +271,128 @@ static void handle_district_settings(AppState* app) {
     }
 }
 
+/* Ask for an output file, defaulting to <prefix>_<seed>.csv in the state's
+   plans directory; .csv keeps it out of the plan list. Returns 0 if no
+   path was given and the default does not fit in outputPath. */
+static int get_output_path(AppState* app, const char* prefix, uint32_t seed,
+                           char* outputPath, size_t size) {
+    char input[MAX_PATH_LEN];
+    char plansDir[MAX_PATH_LEN];
+    char statePlansDir[MAX_PATH_LEN];
+    int len = snprintf(plansDir, sizeof(plansDir), "%s" PATH_SEP "plans", app->dataDir);
+    int stateLen = snprintf(statePlansDir, sizeof(statePlansDir), "%s" PATH_SEP "%s",
+                            plansDir, app->currentState->abbr);
+    int outLen = snprintf(outputPath, size, "%s" PATH_SEP "%s_%u.csv", statePlansDir, prefix, seed);
+    int fits = len > 0 && len < (int)sizeof(plansDir) &&
+               stateLen > 0 && stateLen < (int)sizeof(statePlansDir) &&
+               outLen > 0 && (size_t)outLen < size;
+    if (fits) {
+        ensure_directory(plansDir);
+        ensure_directory(statePlansDir);
+    } else {
+        outputPath[0] = '\0';
+    }
+    
+    get_user_string("Output file (press Enter for default): ", input, sizeof(input));
+    if (input[0]) {
+        strncpy(outputPath, input, size - 1);
+        outputPath[size - 1] = '\0';
+        return 1;
+    }
+    if (!fits) {
+        printf("\nError: Default output path is too long\n");
+    }
+    return fits;
+}
+
+/* Handle ReCom sampler prompts */
+static void handle_recom_menu(AppState* app) {
+    char input[MAX_PATH_LEN];
+    
+    int steps = 1000;
+    get_user_string("Number of chain steps (press Enter for 1000): ", input, sizeof(input));
+    if (input[0] && atoi(input) > 0) {
+        steps = atoi(input);
+    }
+    
+    double tolerance = 0.05;
+    get_user_string("Population tolerance %% (press Enter for 5): ", input, sizeof(input));
+    if (input[0] && atof(input) > 0 && atof(input) < 100) {
+        tolerance = atof(input) / 100.0;
+    }
+    
+    int recordEvery = 1;
+    get_user_string("Record every Nth step (press Enter for 1): ", input, sizeof(input));
+    if (input[0] && atoi(input) > 0) {
+        recordEvery = atoi(input);
+    }
+    
+    uint32_t seed = (uint32_t)time(NULL);
+    get_user_string("Random seed (press Enter for time-based): ", input, sizeof(input));
+    if (input[0]) {
+        seed = (uint32_t)strtoul(input, NULL, 10);
+    }
+    
+    char outputPath[MAX_PATH_LEN];
+    if (!get_output_path(app, "recom", seed, outputPath, sizeof(outputPath))) {
+        printf("\nPress Enter to continue...");
+        getchar();
+        return;
+    }
+    
+    run_recom_chain(app, steps, tolerance, recordEvery, seed, outputPath);
+    
+    printf("\nPress Enter to continue...");
+    getchar();
+}
+
+/* Handle ensemble analysis prompts */
+static void handle_ensemble_menu(AppState* app) {
+    char input[MAX_PATH_LEN];
+    
+    int plans = 10000;
+    get_user_string("Number of plans (press Enter for 10000): ", input, sizeof(input));
+    if (input[0] && atoi(input) > 0) {
+        plans = atoi(input);
+    }
+    
+    double tolerance = 0.05;
+    get_user_string("Population tolerance %% (press Enter for 5): ", input, sizeof(input));
+    if (input[0] && atof(input) > 0 && atof(input) < 100) {
+        tolerance = atof(input) / 100.0;
+    }
+    
+    int burnIn = 200;
+    get_user_string("Burn-in steps per chain (press Enter for 200): ", input, sizeof(input));
+    if (input[0] && atoi(input) >= 0) {
+        burnIn = atoi(input);
+    }
+    
+    int thin = 10;
+    get_user_string("Chain steps between plans (press Enter for 10): ", input, sizeof(input));
+    if (input[0] && atoi(input) > 0) {
+        thin = atoi(input);
+    }
+    
+    uint32_t seed = (uint32_t)time(NULL);
+    get_user_string("Random seed (press Enter for time-based): ", input, sizeof(input));
+    if (input[0]) {
+        seed = (uint32_t)strtoul(input, NULL, 10);
+    }
+    
+    char outputPath[MAX_PATH_LEN];
+    if (!get_output_path(app, "ensemble", seed, outputPath, sizeof(outputPath))) {
+        printf("\nPress Enter to continue...");
+        getchar();
+        return;
+    }
+    
+    run_ensemble(app, plans, burnIn, thin, tolerance, seed, outputPath);
+    
+    printf("\nPress Enter to continue...");
+    getchar();
+}
+
 /* Handle automap menu */
 static void handle_automap_menu(AppState* app) {
     int choice;
@@ -255,9 +410,17 @@ static void handle_automap_menu(AppState* app) {
     }
     
     show_automap_menu(app);
-    choice = get_user_choice(0, 6);
+    choice = get_user_choice(0, 8);
     
     if (choice == 0) return;
+    if (choice == 7) {
+        handle_recom_menu(app);
+        return;
+    }
+    if (choice == 8) {
+        handle_ensemble_menu(app);
+        return;
+    }
     
     int numDistricts = app->currentPlan.numDistricts;
     get_user_string("Number of districts (press Enter for current): ", input, sizeof(input));
@@ -301,22 +464,312 @@ static void handle_automap_menu(AppState* app) {
             return;
     }
     
+    int starts = 1;
+    get_user_string("Number of random starts (press Enter for 1): ", input, sizeof(input));
+    if (input[0]) {
+        int num = atoi(input);
+        if (num >= 1 && num <= 1000) {
+            starts = num;
+        }
+    }
+    
+    printf("\nInitial plan:\n");
+    printf("  1. Whole counties, then region growing\n");
+    printf("  2. Multilevel graph partitioning (large states)\n");
+    get_user_string(app->initialMode == INITIAL_MULTILEVEL ?
+                    "Choice (press Enter for multilevel): " :
+                    "Choice (press Enter for counties): ", input, sizeof(input));
+    if (input[0] == '1') {
+        app->initialMode = INITIAL_COUNTIES;
+    } else if (input[0] == '2') {
+        app->initialMode = INITIAL_MULTILEVEL;
+    }
+    
+    printf("\nPhase 3 optimizer:\n");
+    printf("  1. Greedy border moves\n");
+    printf("  2. Simulated annealing, then greedy\n");
+    get_user_string(app->optimizer == OPTIMIZER_ANNEAL ?
+                    "Choice (press Enter for annealing): " :
+                    "Choice (press Enter for greedy): ", input, sizeof(input));
+    if (input[0] == '1') {
+        app->optimizer = OPTIMIZER_GREEDY;
+    } else if (input[0] == '2') {
+        app->optimizer = OPTIMIZER_ANNEAL;
+    }
+    if (app->optimizer == OPTIMIZER_ANNEAL) {
+        get_user_string("Annealing steps (press Enter for default): ", input, sizeof(input));
+        if (input[0] && atol(input) > 0) {
+            app->anneal.steps = atol(input);
+        }
+        get_user_string("Time limit in seconds (press Enter for none): ", input, sizeof(input));
+        if (input[0] && atof(input) > 0) {
+            app->anneal.seconds = atof(input);
+        }
+    }
+    
     printf("\nGenerating districts...\n");
-    generate_automap(app, numDistricts, preset, customTarget);
+    if (starts > 1) {
+        generate_automap_multistart(app, numDistricts, preset, customTarget, starts,
+                                    (uint32_t)time(NULL));
+    } else {
+        generate_automap(app, numDistricts, preset, customTarget);
+    }
     
     printf("\nPress Enter to continue...");
     getchar();
 }
 
+/* Print command line usage */
+static void print_usage(const char* program) {
+    printf("Usage: %s [options]            Interactive console\n", program);
+    printf("       %s run --state XX [options]  Batch job, no console UI\n", program);
+    printf("\nBatch options:\n");
+    printf("  --state XX                      State to load (required)\n");
+    printf("  --districts N                   Number of districts (default: the state's)\n");
+    printf("  --preset very-r|lean-r|fair|lean-d|very-d  Fairness preset (default fair)\n");
+    printf("  --target PCT                    Custom target Democratic share in percent\n");
+    printf("  --starts N                      Automap random starts (default 1)\n");
+    printf("  --name NAME                     Plan name\n");
+    printf("  --plan-id ID                    Plan id (letters, digits, '-' and '_';\n");
+    printf("                                  default: generated, unique per job)\n");
+    printf("  --out FILE                      Write the plan (binary if FILE ends in .plan, else JSON)\n");
+    printf("  --metrics FILE                  Write plan metrics as JSON\n");
+    printf("  --save                          Also save the plan to the state's plans directory\n");
+    printf("  A batch job prints one JSON result line on stdout and logs to stderr.\n");
+    printf("  Exit codes: 0 ok, 1 usage, 2 load failed, 3 automap failed, 4 write failed\n");
+    printf("\nAutomap options:\n");
+    printf("  --initial counties|multilevel   Phases 1-2 method (default counties)\n");
+    printf("  --optimizer greedy|anneal       Phase 3 optimizer (default greedy)\n");
+    printf("  --anneal-steps N                Annealing proposal budget\n");
+    printf("  --anneal-seconds S              Annealing wall-clock budget\n");
+    printf("  --anneal-start-temp T           Start temperature (default: calibrated)\n");
+    printf("  --anneal-end-temp T             End temperature (default: start / 100)\n");
+    printf("  --seed N                        Random seed for annealing and multiple starts;\n");
+    printf("                                  a single greedy run ignores it\n");
+    printf("\nGeneral options:\n");
+    printf("  --data-dir DIR                  Data directory (default: ./data or ../data)\n");
+    printf("  --adjacency rook|queen          Neighbors share an edge, or also a single vertex\n");
+    printf("                                  (default rook)\n");
+    printf("  --help                          Show this message\n");
+}
+
+/* Fairness preset by command line name; returns 0 if unknown */
+static int parse_preset(const char* name, FairnessPreset* preset) {
+    static const char* names[5] = { "very-r", "lean-r", "fair", "lean-d", "very-d" };
+    for (int p = 0; p < 5; p++) {
+        if (strcmp(name, names[p]) == 0) {
+            *preset = (FairnessPreset)p;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Whole-string integer in [min, max]; returns 0 otherwise */
+static int parse_integer(const char* value, long long min, long long max, long long* out) {
+    char* end;
+    errno = 0;
+    long long v = strtoll(value, &end, 10);
+    if (end == value || *end != '\0' || errno == ERANGE || v < min || v > max) return 0;
+    *out = v;
+    return 1;
+}
+
+/* Whole-string finite number in [min, max]; returns 0 otherwise */
+static int parse_real(const char* value, double min, double max, double* out) {
+    char* end;
+    errno = 0;
+    double v = strtod(value, &end);
+    if (end == value || *end != '\0' || errno == ERANGE || !isfinite(v) || v < min || v > max) return 0;
+    *out = v;
+    return 1;
+}
+
+/* Copy an option value that must fit in buffer; returns 0 if it does not */
+static int copy_option(char* buffer, size_t size, const char* value) {
+    size_t len = strlen(value);
+    if (len >= size) return 0;
+    memcpy(buffer, value, len + 1);
+    return 1;
+}
+
+/* Apply command line options; batch options are only accepted after "run".
+   Returns 0 on a bad option. */
+static int parse_command_line(AppState* app, BatchOptions* batch, int batchMode,
+                              int argc, char* argv[], char* error, size_t errorSize) {
+    for (int i = batchMode ? 2 : 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        
+        if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            print_usage(argv[0]);
+            exit(0);
+        }
+        if (strcmp(arg, "--save") == 0 && batchMode) {
+            batch->save = 1;
+            continue;
+        }
+        if (!value) {
+            snprintf(error, errorSize, "Unknown or incomplete option: %s", arg);
+            return 0;
+        }
+        
+        if (strcmp(arg, "--initial") == 0) {
+            if (strcmp(value, "counties") == 0) {
+                app->initialMode = INITIAL_COUNTIES;
+            } else if (strcmp(value, "multilevel") == 0) {
+                app->initialMode = INITIAL_MULTILEVEL;
+            } else {
+                snprintf(error, errorSize, "Unknown initial plan method: %s", value);
+                return 0;
+            }
+        } else if (strcmp(arg, "--optimizer") == 0) {
+            if (strcmp(value, "greedy") == 0) {
+                app->optimizer = OPTIMIZER_GREEDY;
+            } else if (strcmp(value, "anneal") == 0) {
+                app->optimizer = OPTIMIZER_ANNEAL;
+            } else {
+                snprintf(error, errorSize, "Unknown optimizer: %s", value);
+                return 0;
+            }
+        } else if (strcmp(arg, "--anneal-steps") == 0) {
+            long long steps;
+            if (!parse_integer(value, 0, LONG_MAX, &steps)) {
+                snprintf(error, errorSize, "Annealing steps must be a whole number of at least 0: %s", value);
+                return 0;
+            }
+            app->anneal.steps = (long)steps;
+        } else if (strcmp(arg, "--anneal-seconds") == 0 ||
+                   strcmp(arg, "--anneal-start-temp") == 0 ||
+                   strcmp(arg, "--anneal-end-temp") == 0) {
+            double v;
+            if (!parse_real(value, 0, HUGE_VAL, &v)) {
+                snprintf(error, errorSize, "%s must be a number of at least 0: %s", arg, value);
+                return 0;
+            }
+            if (strcmp(arg, "--anneal-seconds") == 0) {
+                app->anneal.seconds = v;
+            } else if (strcmp(arg, "--anneal-start-temp") == 0) {
+                app->anneal.startTemp = v;
+            } else {
+                app->anneal.endTemp = v;
+            }
+        } else if (strcmp(arg, "--seed") == 0) {
+            long long seed;
+            if (!parse_integer(value, 0, UINT32_MAX, &seed)) {
+                snprintf(error, errorSize, "Seed must be a whole number from 0 to %lu: %s",
+                        (unsigned long)UINT32_MAX, value);
+                return 0;
+            }
+            app->anneal.seed = (uint32_t)seed;
+        } else if (strcmp(arg, "--adjacency") == 0) {
+            if (strcmp(value, "rook") == 0) {
+                app->adjacencyMode = ADJACENCY_ROOK;
+            } else if (strcmp(value, "queen") == 0) {
+                app->adjacencyMode = ADJACENCY_QUEEN;
+            } else {
+                snprintf(error, errorSize, "Unknown adjacency: %s", value);
+                return 0;
+            }
+        } else if (strcmp(arg, "--data-dir") == 0) {
+            if (!copy_option(app->dataDir, sizeof(app->dataDir), value)) {
+                snprintf(error, errorSize, "Data directory is longer than %d characters",
+                        (int)sizeof(app->dataDir) - 1);
+                return 0;
+            }
+        } else if (!batchMode) {
+            snprintf(error, errorSize, "Unknown option: %s (batch options need \"run\")", arg);
+            return 0;
+        } else if (strcmp(arg, "--state") == 0) {
+            if (!copy_option(batch->state, sizeof(batch->state), value)) {
+                snprintf(error, errorSize, "Unknown state: %s", value);
+                return 0;
+            }
+        } else if (strcmp(arg, "--districts") == 0) {
+            long long count;
+            if (!parse_integer(value, 1, MAX_DISTRICTS, &count)) {
+                snprintf(error, errorSize, "District count must be between 1 and %d", MAX_DISTRICTS);
+                return 0;
+            }
+            batch->numDistricts = (int)count;
+        } else if (strcmp(arg, "--preset") == 0) {
+            if (!parse_preset(value, &batch->preset)) {
+                snprintf(error, errorSize, "Unknown fairness preset: %s", value);
+                return 0;
+            }
+        } else if (strcmp(arg, "--target") == 0) {
+            double target;
+            if (!parse_real(value, 0, 100, &target) || target <= 0 || target >= 100) {
+                snprintf(error, errorSize, "Target must be a percentage between 0 and 100");
+                return 0;
+            }
+            batch->customTarget = target / 100.0;
+        } else if (strcmp(arg, "--starts") == 0) {
+            long long starts;
+            if (!parse_integer(value, 1, INT_MAX, &starts)) {
+                snprintf(error, errorSize, "Starts must be a whole number of at least 1");
+                return 0;
+            }
+            batch->starts = (int)starts;
+        } else if (strcmp(arg, "--name") == 0) {
+            if (!copy_option(batch->planName, sizeof(batch->planName), value)) {
+                snprintf(error, errorSize, "Plan name is longer than %d characters",
+                        (int)sizeof(batch->planName) - 1);
+                return 0;
+            }
+        } else if (strcmp(arg, "--plan-id") == 0) {
+            size_t len = strlen(value);
+            if (len == 0 || len >= sizeof(batch->planId) || strspn(value,
+                    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_") != len) {
+                snprintf(error, errorSize, "Plan id must be 1-%d letters, digits, '-' or '_'",
+                        (int)sizeof(batch->planId) - 1);
+                return 0;
+            }
+            memcpy(batch->planId, value, len + 1);
+        } else if (strcmp(arg, "--out") == 0 || strcmp(arg, "--metrics") == 0) {
+            char* path = strcmp(arg, "--out") == 0 ? batch->outPath : batch->metricsPath;
+            if (!copy_option(path, MAX_PATH_LEN, value)) {
+                snprintf(error, errorSize, "%s path is longer than %d characters", arg, MAX_PATH_LEN - 1);
+                return 0;
+            }
+        } else {
+            snprintf(error, errorSize, "Unknown option: %s", arg);
+            return 0;
+        }
+        i++;
+    }
+    return 1;
+}
+
 /* Main program */
 int main(int argc, char* argv[]) {
-    (void)argc;
-    (void)argv;
     AppState app;
+    BatchOptions batch;
     int choice;
+    int batchMode = argc > 1 && strcmp(argv[1], "run") == 0;
+    
+    /* Batch jobs keep stdout for their JSON result line */
+    if (batchMode && !batch_capture_stdout()) {
+        return BATCH_USAGE;
+    }
     
     /* Initialize */
     init_app(&app);
+    memset(&batch, 0, sizeof(batch));
+    batch.preset = FAIRNESS_FAIR;
+    batch.starts = 1;
+    char error[MAX_PATH_LEN];
+    if (!parse_command_line(&app, &batch, batchMode, argc, argv, error, sizeof(error))) {
+        print_usage(argv[0]);
+        if (batchMode) {
+            return batch_usage_error(error);
+        }
+        fprintf(stderr, "\nError: %s\n", error);
+        return BATCH_USAGE;
+    }
+    if (batchMode) {
+        return run_batch(&app, &batch);
+    }
     
     /* Load states list */
     printf("Loading states list...\n");
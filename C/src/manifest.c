@@ -0,0 +1,356 @@
+/*
+ * US Redistricting Tool - Plan Manifest
+ *
+ * Each state's plans directory keeps plans.manifest, an index of its saved
+ * plans: id, name, file, district count, last update and summary metrics,
+ * one fixed-size PlanListing per plan file. Listing plans reads the
+ * manifest and stats the directory; a plan file is only opened when the
+ * manifest has no record of it or its size or modification time has
+ * changed, so opening a state costs O(plans) small records however large
+ * the plans are. A JSON export shares its plan id with the binary plan it
+ * came from; listings show the binary one.
+ *
+ * Saving a plan updates its record straight away. The manifest is always
+ * replaced whole through a per-process temp file and rename, so readers see
+ * either the old or the new index. A record lost to two processes saving at once is
+ * picked up again by the next directory scan. Deleting the manifest, or
+ * asking for a rebuild, re-reads every plan file.
+ *
+ * File layout (native byte order):
+ *   ManifestHeader
+ *   PlanListing[count]
+ */
+
+#include "../include/maps.h"
+#include "../lib/cJSON.h"
+
+#ifdef _WIN32
+#include <sys/stat.h>
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#define MANIFEST_MAGIC "PLANIDX"
+#define MANIFEST_VERSION 1
+#define MANIFEST_FILE "plans.manifest"
+
+extern char* read_file(const char* path);
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t count;
+    uint32_t reserved;
+} ManifestHeader;
+
+/* Returns 0 if the directory path does not fit in buffer */
+static int get_state_plans_dir(const AppState* app, const char* stateCode, char* buffer, size_t size) {
+    int len = snprintf(buffer, size, "%s" PATH_SEP "plans" PATH_SEP "%s", app->dataDir, stateCode);
+    return len > 0 && (size_t)len < size;
+}
+
+/* Make room for count listings in app->plans */
+static int reserve_listings(AppState* app, int count) {
+    if (count <= app->planCapacity) return 1;
+    int capacity = app->planCapacity > 0 ? app->planCapacity : 16;
+    while (capacity < count) capacity *= 2;
+    PlanListing* grown = (PlanListing*)realloc(app->plans, sizeof(PlanListing) * capacity);
+    if (!grown) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        return 0;
+    }
+    app->plans = grown;
+    app->planCapacity = capacity;
+    return 1;
+}
+
+static int file_stamp(const char* path, int64_t* size, int64_t* mtime) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return 0;
+    }
+    *size = (int64_t)st.st_size;
+    *mtime = (int64_t)st.st_mtime;
+    return 1;
+}
+
+/* Records of a manifest file; returns 0 (and no records) if it is missing
+   or unreadable */
+static int read_manifest(const char* path, PlanListing** records, int* count) {
+    *records = NULL;
+    *count = 0;
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return 0;
+    }
+    ManifestHeader h;
+    int ok = fread(&h, sizeof(h), 1, file) == 1 &&
+             memcmp(h.magic, MANIFEST_MAGIC, sizeof(h.magic)) == 0 &&
+             h.version == MANIFEST_VERSION &&
+             h.recordSize == sizeof(PlanListing) &&
+             h.count < INT32_MAX / sizeof(PlanListing);
+    if (ok && h.count > 0) {
+        *records = (PlanListing*)malloc(sizeof(PlanListing) * h.count);
+        ok = *records && fread(*records, sizeof(PlanListing), h.count, file) == h.count;
+    }
+    fclose(file);
+    if (!ok) {
+        free(*records);
+        *records = NULL;
+        return 0;
+    }
+    for (uint32_t i = 0; i < h.count; i++) {
+        PlanListing* r = &(*records)[i];
+        r->planId[sizeof(r->planId) - 1] = '\0';
+        r->name[sizeof(r->name) - 1] = '\0';
+        r->fileName[sizeof(r->fileName) - 1] = '\0';
+        r->lastUpdated[sizeof(r->lastUpdated) - 1] = '\0';
+    }
+    *count = (int)h.count;
+    return 1;
+}
+
+/* Replace the manifest with app->plans; the temp file is named for this
+   process so two processes saving at once never write the same one */
+static int write_manifest(const AppState* app, const char* path) {
+    char tempPath[MAX_PATH_LEN + 64];
+    int len = snprintf(tempPath, sizeof(tempPath), "%s.%lu.tmp", path, (unsigned long)getpid());
+    if (len < 0 || len >= (int)sizeof(tempPath)) return 0;
+
+    ManifestHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, MANIFEST_MAGIC, sizeof(h.magic));
+    h.version = MANIFEST_VERSION;
+    h.recordSize = sizeof(PlanListing);
+    h.count = (uint32_t)app->planCount;
+
+    int ok = 0;
+    FILE* file = fopen(tempPath, "wb");
+    if (file) {
+        ok = fwrite(&h, sizeof(h), 1, file) == 1 &&
+             fwrite(app->plans, sizeof(PlanListing), app->planCount, file) == (size_t)app->planCount &&
+             sync_file(file);
+        ok = (fclose(file) == 0) && ok;
+    }
+    if (ok) {
+        ok = replace_file(tempPath, path);
+    }
+    if (!ok) {
+        remove(tempPath);
+        fprintf(stderr, "Warning: could not write plan manifest: %s\n", path);
+    }
+    return ok;
+}
+
+/* Read a plan file's listing: binary plans from their header, scored when
+   they match the loaded precincts; JSON plans by parsing them */
+static int describe_plan_file(const AppState* app, const char* path, const char* ext,
+                              PlanListing* out, int* scratch) {
+    if (strcmp(ext, ".plan") == 0) {
+        if (!read_plan_info(path, out)) return 0;
+        DistrictLedger ledger;
+        memset(&ledger, 0, sizeof(ledger));
+        if (scratch && out->numDistricts > 0 &&
+            read_plan_assignment(app, path, scratch, NULL) &&
+            ledger_rebuild(&ledger, app, scratch)) {
+            summarize_plan(app, scratch, &ledger, out->numDistricts, &out->summary);
+            out->hasSummary = 1;
+        }
+        ledger_free(&ledger);
+        return 1;
+    }
+
+    char* jsonStr = read_file(path);
+    if (!jsonStr) return 0;
+    cJSON* root = cJSON_Parse(jsonStr);
+    free(jsonStr);
+    if (!root) return 0;
+
+    memset(out, 0, sizeof(PlanListing));
+    cJSON* planId = cJSON_GetObjectItem(root, "planId");
+    cJSON* name = cJSON_GetObjectItem(root, "name");
+    cJSON* numDistricts = cJSON_GetObjectItem(root, "numDistricts");
+    cJSON* lastUpdated = cJSON_GetObjectItem(root, "lastUpdated");
+    if (planId && cJSON_IsString(planId)) {
+        strncpy(out->planId, planId->valuestring, sizeof(out->planId) - 1);
+    } else {
+        /* Use the file name without extension */
+        const char* base = strrchr(path, PATH_SEP[0]);
+        base = base ? base + 1 : path;
+        size_t len = (size_t)(ext - base);
+        if (len > sizeof(out->planId) - 1) len = sizeof(out->planId) - 1;
+        memcpy(out->planId, base, len);
+    }
+    strncpy(out->name, name && cJSON_IsString(name) ? name->valuestring : "(untitled)",
+            sizeof(out->name) - 1);
+    if (numDistricts && cJSON_IsNumber(numDistricts)) {
+        out->numDistricts = numDistricts->valueint;
+    }
+    if (lastUpdated && cJSON_IsString(lastUpdated)) {
+        strncpy(out->lastUpdated, lastUpdated->valuestring, sizeof(out->lastUpdated) - 1);
+    }
+    cJSON_Delete(root);
+    return 1;
+}
+
+static int add_listing(AppState* app, const PlanListing* listing) {
+    if (!reserve_listings(app, app->planCount + 1)) return 0;
+    app->plans[app->planCount++] = *listing;
+    return 1;
+}
+
+/* By plan id, then file name */
+static int compare_listings(const void* a, const void* b) {
+    const PlanListing* x = (const PlanListing*)a;
+    const PlanListing* y = (const PlanListing*)b;
+    int c = strcmp(x->planId, y->planId);
+    return c != 0 ? c : strcmp(x->fileName, y->fileName);
+}
+
+/* Consider one directory entry, reusing its manifest record while the file
+   is unchanged; returns 1 if the file had to be read */
+static int scan_plan_file(AppState* app, const char* plansDir, const char* fileName,
+                          const PlanListing* old, int oldCount, int* scratch) {
+    const char* ext = strrchr(fileName, '.');
+    if (!ext || (strcmp(ext, ".plan") != 0 && strcmp(ext, ".json") != 0)) return 0;
+    size_t nameLen = strlen(fileName);
+    if (nameLen >= sizeof(((PlanListing*)0)->fileName)) return 0;
+
+    char path[MAX_PATH_LEN];
+    int len = snprintf(path, sizeof(path), "%s" PATH_SEP "%s", plansDir, fileName);
+    if (len < 0 || len >= (int)sizeof(path)) return 0;
+    int64_t size, mtime;
+    if (!file_stamp(path, &size, &mtime)) return 0;
+
+    for (int i = 0; i < oldCount; i++) {
+        if (strcmp(old[i].fileName, fileName) == 0 &&
+            old[i].fileSize == size && old[i].fileMtime == mtime) {
+            add_listing(app, &old[i]);
+            return 0;
+        }
+    }
+
+    PlanListing listing;
+    if (describe_plan_file(app, path, ext, &listing, scratch)) {
+        memcpy(listing.fileName, fileName, nameLen + 1);
+        listing.fileSize = size;
+        listing.fileMtime = mtime;
+        add_listing(app, &listing);
+    }
+    /* Unreadable files count as changes too, so they leave the manifest */
+    return 1;
+}
+
+/* List a state's saved plans into app->plans from its manifest, reading
+   only plan files the manifest does not describe (every file if rebuild is
+   set) and writing the manifest back when anything changed */
+int refresh_plan_manifest(AppState* app, const char* stateCode, int rebuild) {
+    char plansDir[MAX_PATH_LEN];
+    app->planCount = 0;
+    if (!get_state_plans_dir(app, stateCode, plansDir, sizeof(plansDir))) {
+        return 0;
+    }
+    char manifestPath[MAX_PATH_LEN + 32];
+    snprintf(manifestPath, sizeof(manifestPath), "%s" PATH_SEP MANIFEST_FILE, plansDir);
+
+    if (!file_exists(plansDir)) {
+        return 0;
+    }
+
+    PlanListing* old = NULL;
+    int oldCount = 0;
+    if (!rebuild) {
+        read_manifest(manifestPath, &old, &oldCount);
+    }
+    int* scratch = app->precinctCount > 0 ? (int*)malloc(sizeof(int) * app->precinctCount) : NULL;
+    int changed = 0;
+
+#ifdef _WIN32
+    WIN32_FIND_DATA findData;
+    char searchPath[MAX_PATH_LEN];
+    snprintf(searchPath, sizeof(searchPath), "%s" PATH_SEP "*", plansDir);
+
+    HANDLE hFind = FindFirstFile(searchPath, &findData);
+    if (hFind != INVALID_HANDLE_VALUE) {
+        do {
+            if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+                changed |= scan_plan_file(app, plansDir, findData.cFileName, old, oldCount, scratch);
+            }
+        } while (FindNextFile(hFind, &findData));
+        FindClose(hFind);
+    }
+#else
+    DIR* dir = opendir(plansDir);
+    if (dir) {
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+            changed |= scan_plan_file(app, plansDir, entry->d_name, old, oldCount, scratch);
+        }
+        closedir(dir);
+    }
+#endif
+
+    if (app->planCount > 1) {
+        qsort(app->plans, app->planCount, sizeof(PlanListing), compare_listings);
+    }
+    /* Files that disappeared leave fewer records than before */
+    if (rebuild || changed || app->planCount != oldCount || !file_exists(manifestPath)) {
+        write_manifest(app, manifestPath);
+    }
+
+    free(old);
+    free(scratch);
+    return app->planCount;
+}
+
+/* Record the plan just saved to planPath in its state's manifest */
+int record_saved_plan(AppState* app, const char* planPath) {
+    char plansDir[MAX_PATH_LEN];
+    if (!get_state_plans_dir(app, app->currentPlan.state, plansDir, sizeof(plansDir))) {
+        return 0;
+    }
+    char manifestPath[MAX_PATH_LEN + 32];
+    snprintf(manifestPath, sizeof(manifestPath), "%s" PATH_SEP MANIFEST_FILE, plansDir);
+
+    PlanListing listing;
+    memset(&listing, 0, sizeof(listing));
+    const char* base = strrchr(planPath, PATH_SEP[0]);
+    base = base ? base + 1 : planPath;
+    size_t nameLen = strlen(base);
+    if (nameLen >= sizeof(listing.fileName)) return 0;
+    memcpy(listing.fileName, base, nameLen + 1);
+    /* Listing fields are as wide as the Plan's, so copy them whole */
+    memcpy(listing.planId, app->currentPlan.planId, sizeof(listing.planId));
+    memcpy(listing.name, app->currentPlan.name, sizeof(listing.name));
+    memcpy(listing.lastUpdated, app->currentPlan.lastUpdated, sizeof(listing.lastUpdated));
+    listing.planId[sizeof(listing.planId) - 1] = '\0';
+    listing.name[sizeof(listing.name) - 1] = '\0';
+    listing.lastUpdated[sizeof(listing.lastUpdated) - 1] = '\0';
+    listing.numDistricts = app->currentPlan.numDistricts;
+    summarize_plan(app, app->district, &app->ledger, listing.numDistricts, &listing.summary);
+    listing.hasSummary = 1;
+    if (!file_stamp(planPath, &listing.fileSize, &listing.fileMtime)) {
+        return 0;
+    }
+
+    /* Start from the manifest on disk so records saved by others are kept */
+    PlanListing* records = NULL;
+    int count = 0;
+    read_manifest(manifestPath, &records, &count);
+    app->planCount = 0;
+    int ok = reserve_listings(app, count + 1);
+    for (int i = 0; ok && i < count; i++) {
+        if (strcmp(records[i].fileName, listing.fileName) != 0) {
+            app->plans[app->planCount++] = records[i];
+        }
+    }
+    free(records);
+    if (!ok) return 0;
+
+    app->plans[app->planCount++] = listing;
+    qsort(app->plans, app->planCount, sizeof(PlanListing), compare_listings);
+    return write_manifest(app, manifestPath);
+}
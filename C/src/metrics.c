@@ -26,7 +26,7 @@ static void approximate_geometry(AppState* app, int districtId, double* area, do
     double minX = 1e9, maxX = -1e9, minY = 1e9, maxY = -1e9;
     
     for (int i = 0; i < app->precinctCount; i++) {
-        if (app->precincts[i].district == districtId) {
+        if (app->district[i] == districtId) {
             count++;
             double x = app->precincts[i].centroid.x;
             double y = app->precincts[i].centroid.y;
@@ -49,48 +49,19 @@ static void approximate_geometry(AppState* app, int districtId, double* area, do
 
 /* Compute statistics for all districts */
 void compute_district_stats(AppState* app, DistrictStats* stats, int numDistricts) {
-    /* Initialize stats */
+    /* Totals come from the ledger kept in step with district[] */
+    const DistrictLedger* ledger = &app->ledger;
     for (int d = 1; d <= numDistricts; d++) {
         stats[d - 1].districtId = d;
-        stats[d - 1].population = 0;
-        stats[d - 1].demVotes = 0;
-        stats[d - 1].repVotes = 0;
+        stats[d - 1].population = ledger->population[d];
+        stats[d - 1].demVotes = ledger->dem[d];
+        stats[d - 1].repVotes = ledger->rep[d];
         stats[d - 1].demShare = 0.5;
         stats[d - 1].compactness = 0;
         stats[d - 1].area = 0;
         stats[d - 1].perimeter = 0;
-        stats[d - 1].precinctCount = 0;
-        stats[d - 1].countyCount = 0;
-    }
-    
-    /* Count unique counties per district */
-    char counties[MAX_DISTRICTS][100][MAX_NAME_LEN]; /* district -> list of counties */
-    int countyCounts[MAX_DISTRICTS] = {0};
-    
-    /* Aggregate precinct data */
-    for (int i = 0; i < app->precinctCount; i++) {
-        Precinct* p = &app->precincts[i];
-        int d = p->district;
-        
-        if (d < 1 || d > numDistricts) continue;
-        
-        stats[d - 1].population += p->population;
-        stats[d - 1].demVotes += p->dem;
-        stats[d - 1].repVotes += p->rep;
-        stats[d - 1].precinctCount++;
-        
-        /* Track unique counties */
-        int found = 0;
-        for (int c = 0; c < countyCounts[d - 1]; c++) {
-            if (strcmp(counties[d - 1][c], p->county) == 0) {
-                found = 1;
-                break;
-            }
-        }
-        if (!found && countyCounts[d - 1] < 100) {
-            strncpy(counties[d - 1][countyCounts[d - 1]], p->county, MAX_NAME_LEN - 1);
-            countyCounts[d - 1]++;
-        }
+        stats[d - 1].precinctCount = ledger->precinctCount[d];
+        stats[d - 1].countyCount = ledger->countyCount[d];
     }
     
     /* Calculate derived metrics */
@@ -100,8 +71,6 @@ void compute_district_stats(AppState* app, DistrictStats* stats, int numDistrict
             stats[d - 1].demShare = (double)stats[d - 1].demVotes / total;
         }
         
-        stats[d - 1].countyCount = countyCounts[d - 1];
-        
         /* Calculate geometry approximation */
         double area, perimeter;
         approximate_geometry(app, d, &area, &perimeter);
@@ -111,6 +80,72 @@ void compute_district_stats(AppState* app, DistrictStats* stats, int numDistrict
     }
 }
 
+/* Seats, efficiency gap, population deviation and mean compactness of a
+   plan in one pass over its precincts. Uses only fixed-size stack arrays,
+   so ensemble workers can call it for every sampled plan. */
+void summarize_plan(const AppState* app, const int* district, const DistrictLedger* ledger,
+                    int numDistricts, PlanSummary* out) {
+    double minX[MAX_DISTRICTS + 1], maxX[MAX_DISTRICTS + 1];
+    double minY[MAX_DISTRICTS + 1], maxY[MAX_DISTRICTS + 1];
+    
+    for (int d = 1; d <= numDistricts; d++) {
+        minX[d] = minY[d] = 1e9;
+        maxX[d] = maxY[d] = -1e9;
+    }
+    for (int i = 0; i < app->precinctCount; i++) {
+        int d = district[i];
+        if (d < 1 || d > numDistricts) continue;
+        double x = app->precincts[i].centroid.x;
+        double y = app->precincts[i].centroid.y;
+        if (x < minX[d]) minX[d] = x;
+        if (x > maxX[d]) maxX[d] = x;
+        if (y < minY[d]) minY[d] = y;
+        if (y > maxY[d]) maxY[d] = y;
+    }
+    
+    /* Every vote in the state counts toward the efficiency gap denominator */
+    long totalVotes = 0;
+    for (int d = 0; d <= MAX_DISTRICTS; d++) {
+        totalVotes += ledger->dem[d] + ledger->rep[d];
+    }
+    long assignedPop = 0;
+    for (int d = 1; d <= numDistricts; d++) {
+        assignedPop += ledger->population[d];
+    }
+    double idealPop = numDistricts > 0 ? (double)assignedPop / numDistricts : 0;
+    
+    long wastedDem = 0, wastedRep = 0;
+    double maxDev = 0, compactSum = 0;
+    int populated = 0;
+    out->demSeats = 0;
+    for (int d = 1; d <= numDistricts; d++) {
+        if (ledger->precinctCount[d] == 0) continue;
+        populated++;
+        
+        int votes = ledger->dem[d] + ledger->rep[d];
+        int threshold = votes / 2 + 1;
+        if (ledger->dem[d] > ledger->rep[d]) {
+            out->demSeats++;
+            wastedDem += ledger->dem[d] - threshold;
+            wastedRep += ledger->rep[d];
+        } else {
+            wastedRep += ledger->rep[d] - threshold;
+            wastedDem += ledger->dem[d];
+        }
+        
+        double dev = idealPop > 0 ? fabs(ledger->population[d] - idealPop) / idealPop : 0;
+        if (dev > maxDev) maxDev = dev;
+        
+        double width = maxX[d] - minX[d];
+        double height = maxY[d] - minY[d];
+        compactSum += calculate_compactness(width * height, 2 * (width + height));
+    }
+    
+    out->efficiencyGap = totalVotes > 0 ? 100.0 * (wastedDem - wastedRep) / totalVotes : 0;
+    out->maxDeviation = 100.0 * maxDev;
+    out->compactness = populated > 0 ? compactSum / populated : 0;
+}
+
 /* Print detailed metrics for current plan */
 void print_metrics(AppState* app) {
     if (!app->hasPlan || !app->currentState) {
@@ -131,10 +166,10 @@ void print_metrics(AppState* app) {
     int assignedPrecincts = 0;
     
     for (int i = 0; i < app->precinctCount; i++) {
-        totalPop += app->precincts[i].population;
-        totalDem += app->precincts[i].dem;
-        totalRep += app->precincts[i].rep;
-        if (app->precincts[i].district > 0) {
+        totalPop += app->population[i];
+        totalDem += app->dem[i];
+        totalRep += app->rep[i];
+        if (app->district[i] > 0) {
             assignedPrecincts++;
         }
     }
@@ -207,27 +242,9 @@ void print_metrics(AppState* app) {
            (totalDem + totalRep) > 0 ? 100.0 * totalDem / (totalDem + totalRep) : 50.0);
     
     /* Efficiency gap calculation */
-    int wastedDem = 0, wastedRep = 0;
-    for (int d = 1; d <= numDistricts; d++) {
-        DistrictStats* s = &stats[d - 1];
-        if (s->precinctCount == 0) continue;
-        
-        int totalVotes = s->demVotes + s->repVotes;
-        int threshold = totalVotes / 2 + 1;
-        
-        if (s->demVotes > s->repVotes) {
-            /* Dem won - wasted Dem votes above threshold, all Rep votes */
-            wastedDem += s->demVotes - threshold;
-            wastedRep += s->repVotes;
-        } else {
-            /* Rep won */
-            wastedRep += s->repVotes - threshold;
-            wastedDem += s->demVotes;
-        }
-    }
-    
-    int totalVotes = totalDem + totalRep;
-    double efficiencyGap = totalVotes > 0 ? 100.0 * (wastedDem - wastedRep) / totalVotes : 0;
+    PlanSummary summary;
+    summarize_plan(app, app->district, &app->ledger, numDistricts, &summary);
+    double efficiencyGap = summary.efficiencyGap;
     
     printf("║   Efficiency Gap: %+6.2f%% (positive favors R, negative favors D)            ║\n", efficiencyGap);
     printf("╚══════════════════════════════════════════════════════════════════════════════╝\n");
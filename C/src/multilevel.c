@@ -0,0 +1,547 @@
+/*
+ * US Redistricting Tool - Multilevel Partitioner
+ *
+ * Builds an initial plan for very large states without growing districts
+ * one precinct at a time:
+ *
+ * 1. Coarsen: collapse the adjacency graph level by level with heavy-edge
+ *    matching. Vertex weights are populations and edge weights count the
+ *    fine edges a coarse edge stands for, so each level keeps the shape of
+ *    the one below it at about half the size.
+ * 2. Partition the coarsest graph into balanced parts by graph growing.
+ * 3. Uncoarsen: project the parts back down one level at a time and run a
+ *    few boundary refinement passes at each level, moving precincts that
+ *    cut fewer edges or improve population balance.
+ *
+ * Before the finest level is refined, detached fragments of each part are
+ * merged into the part they border most, and that last refinement only
+ * makes moves that keep parts in one piece, so districts come out
+ * contiguous wherever the graph allows. Every pass is linear in the graph
+ * size.
+ */
+
+#include "../include/maps.h"
+
+/* Stop coarsening at this many vertices per district, or when a level
+   shrinks the graph by less than MULTILEVEL_MIN_SHRINK */
+#define MULTILEVEL_COARSEST_PER_DISTRICT 20
+#define MULTILEVEL_MIN_SHRINK 0.95
+
+/* Population balance the refinement aims for at the finest level */
+#define MULTILEVEL_BALANCE 0.02
+
+/* Refinement passes per level */
+#define MULTILEVEL_REFINE_PASSES 8
+
+typedef struct {
+    int n;
+    int* xadj;         /* CSR row offsets */
+    int* adj;
+    int* ewgt;         /* Edge weights, NULL = all 1 */
+    int* vwgt;         /* Population per vertex */
+    int* cmap;         /* Vertex -> vertex of the next coarser level */
+    int* part;         /* 0-based part per vertex */
+    int owned;         /* Graph arrays belong to this level */
+} MlLevel;
+
+static void free_level(MlLevel* level) {
+    if (level->owned) {
+        free(level->xadj);
+        free(level->adj);
+        free(level->ewgt);
+        free(level->vwgt);
+    }
+    free(level->cmap);
+    free(level->part);
+    memset(level, 0, sizeof(MlLevel));
+}
+
+static int edge_weight(const MlLevel* level, int k) {
+    return level->ewgt ? level->ewgt[k] : 1;
+}
+
+/* Heavy-edge matching: visit vertices in random order and pair each
+   unmatched vertex with the unmatched neighbor joined by the heaviest edge,
+   keeping pairs under the weight cap. Builds the coarser level. */
+static int coarsen_level(MlLevel* fine, MlLevel* coarse, int maxWeight, uint32_t* rng) {
+    int n = fine->n;
+    int* order = (int*)malloc(sizeof(int) * n);
+    int* match = (int*)malloc(sizeof(int) * n);
+    int* rep = (int*)malloc(sizeof(int) * n);
+    fine->cmap = (int*)malloc(sizeof(int) * n);
+    memset(coarse, 0, sizeof(MlLevel));
+    if (!order || !match || !rep || !fine->cmap) {
+        free(order);
+        free(match);
+        free(rep);
+        return 0;
+    }
+
+    for (int i = 0; i < n; i++) {
+        order[i] = i;
+        match[i] = -1;
+    }
+    for (int i = n - 1; i > 0; i--) {
+        int j = (int)random_below(rng, (uint32_t)(i + 1));
+        int t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+
+    for (int i = 0; i < n; i++) {
+        int u = order[i];
+        if (match[u] >= 0) continue;
+        int best = -1, bestWeight = -1;
+        for (int k = fine->xadj[u]; k < fine->xadj[u + 1]; k++) {
+            int v = fine->adj[k];
+            if (match[v] >= 0 || v == u || fine->vwgt[u] + fine->vwgt[v] > maxWeight) continue;
+            int w = edge_weight(fine, k);
+            if (w > bestWeight || (w == bestWeight && fine->vwgt[v] < fine->vwgt[best])) {
+                best = v;
+                bestWeight = w;
+            }
+        }
+        if (best < 0) {
+            match[u] = u;
+        } else {
+            match[u] = best;
+            match[best] = u;
+        }
+    }
+
+    /* Number coarse vertices in fine index order */
+    int cn = 0;
+    for (int u = 0; u < n; u++) {
+        fine->cmap[u] = -1;
+    }
+    for (int u = 0; u < n; u++) {
+        if (fine->cmap[u] >= 0) continue;
+        fine->cmap[u] = cn;
+        fine->cmap[match[u]] = cn;
+        rep[cn++] = u;
+    }
+
+    int edgeCapacity = fine->xadj[n];
+    coarse->n = cn;
+    coarse->owned = 1;
+    coarse->xadj = (int*)malloc(sizeof(int) * (cn + 1));
+    coarse->adj = (int*)malloc(sizeof(int) * (edgeCapacity > 0 ? edgeCapacity : 1));
+    coarse->ewgt = (int*)malloc(sizeof(int) * (edgeCapacity > 0 ? edgeCapacity : 1));
+    coarse->vwgt = (int*)calloc(cn > 0 ? cn : 1, sizeof(int));
+    int* marker = order;   /* Reused: coarse vertex -> slot in the current row */
+    if (!coarse->xadj || !coarse->adj || !coarse->ewgt || !coarse->vwgt) {
+        free(order);
+        free(match);
+        free(rep);
+        free_level(coarse);
+        return 0;
+    }
+
+    /* Contract: merge the two members' rows, summing parallel edges */
+    for (int c = 0; c < cn; c++) {
+        marker[c] = -1;
+    }
+    int edges = 0;
+    coarse->xadj[0] = 0;
+    for (int c = 0; c < cn; c++) {
+        int rowStart = edges;
+        int members[2] = { rep[c], match[rep[c]] };
+        int memberCount = members[0] == members[1] ? 1 : 2;
+        for (int m = 0; m < memberCount; m++) {
+            int u = members[m];
+            coarse->vwgt[c] += fine->vwgt[u];
+            for (int k = fine->xadj[u]; k < fine->xadj[u + 1]; k++) {
+                int cv = fine->cmap[fine->adj[k]];
+                if (cv == c) continue;
+                if (marker[cv] >= rowStart) {
+                    coarse->ewgt[marker[cv]] += edge_weight(fine, k);
+                } else {
+                    marker[cv] = edges;
+                    coarse->adj[edges] = cv;
+                    coarse->ewgt[edges] = edge_weight(fine, k);
+                    edges++;
+                }
+            }
+        }
+        coarse->xadj[c + 1] = edges;
+    }
+
+    free(order);
+    free(match);
+    free(rep);
+    return 1;
+}
+
+/* Grow parts one at a time by breadth-first search from a peripheral
+   vertex, each up to its share of the population still unassigned */
+static int initial_partition(MlLevel* level, int parts, long total) {
+    int n = level->n;
+    int* queue = (int*)malloc(sizeof(int) * (n > 0 ? n : 1));
+    char* seen = (char*)malloc(n > 0 ? n : 1);
+    level->part = (int*)malloc(sizeof(int) * (n > 0 ? n : 1));
+    if (!queue || !seen || !level->part) {
+        free(queue);
+        free(seen);
+        return 0;
+    }
+    for (int v = 0; v < n; v++) {
+        level->part[v] = -1;
+    }
+
+    long remaining = total;
+    int next = 0;              /* Lowest index that may still be unassigned */
+    for (int p = 0; p < parts - 1; p++) {
+        double target = (double)remaining / (parts - p);
+        long weight = 0;
+
+        while (weight < target) {
+            while (next < n && level->part[next] >= 0) next++;
+            if (next >= n) break;
+
+            /* Peripheral seed: last vertex reached from next through
+               unassigned vertices */
+            memset(seen, 0, n);
+            int head = 0, tail = 0;
+            queue[tail++] = next;
+            seen[next] = 1;
+            while (head < tail) {
+                int v = queue[head++];
+                for (int k = level->xadj[v]; k < level->xadj[v + 1]; k++) {
+                    int w = level->adj[k];
+                    if (!seen[w] && level->part[w] < 0) {
+                        seen[w] = 1;
+                        queue[tail++] = w;
+                    }
+                }
+            }
+            int seed = queue[tail - 1];
+
+            /* Grow from the seed */
+            memset(seen, 0, n);
+            head = tail = 0;
+            queue[tail++] = seed;
+            seen[seed] = 1;
+            while (head < tail && weight < target) {
+                int v = queue[head++];
+                /* Take the vertex if that lands closer to the target */
+                if (weight + level->vwgt[v] - target > target - weight && weight > 0) break;
+                level->part[v] = p;
+                weight += level->vwgt[v];
+                for (int k = level->xadj[v]; k < level->xadj[v + 1]; k++) {
+                    int w = level->adj[k];
+                    if (!seen[w] && level->part[w] < 0) {
+                        seen[w] = 1;
+                        queue[tail++] = w;
+                    }
+                }
+            }
+            if (head < tail || weight >= target) break;
+        }
+        remaining -= weight;
+    }
+    for (int v = 0; v < n; v++) {
+        if (level->part[v] < 0) level->part[v] = parts - 1;
+    }
+
+    free(queue);
+    free(seen);
+    return 1;
+}
+
+/* Boundary refinement: move vertices to a neighboring part when that cuts
+   fewer edges without breaking balance, or when it relieves an overweight
+   part or fills an underweight one. With a contiguity checker, moves that
+   would split a part are skipped. */
+static int refine_level(MlLevel* level, int parts, long* partWeight, double tolerance,
+                        long total, ContiguityChecker* contiguity) {
+    double target = (double)total / parts;
+    double maxWeight = target * (1 + tolerance);
+    double minWeight = target * (1 - tolerance);
+    long* conn = (long*)calloc(parts, sizeof(long));
+    int* touched = (int*)malloc(sizeof(int) * parts);
+    if (!conn || !touched) {
+        free(conn);
+        free(touched);
+        return 0;
+    }
+
+    for (int pass = 0; pass < MULTILEVEL_REFINE_PASSES; pass++) {
+        int moves = 0;
+        for (int v = 0; v < level->n; v++) {
+            int a = level->part[v];
+            int touchedCount = 0;
+            int boundary = 0;
+            for (int k = level->xadj[v]; k < level->xadj[v + 1]; k++) {
+                int b = level->part[level->adj[k]];
+                if (conn[b] == 0) touched[touchedCount++] = b;
+                conn[b] += edge_weight(level, k);
+                if (b != a) boundary = 1;
+            }
+
+            if (boundary) {
+                long w = level->vwgt[v];
+                long internal = conn[a];
+                int best = -1;
+                long bestGain = 0;
+                for (int t = 0; t < touchedCount; t++) {
+                    int b = touched[t];
+                    if (b == a || partWeight[b] + w > maxWeight) continue;
+                    long gain = conn[b] - internal;
+                    int allowed;
+                    if (partWeight[a] > maxWeight || partWeight[b] < minWeight) {
+                        /* Balance first: accept any gain that moves weight downhill */
+                        allowed = partWeight[b] + w < partWeight[a];
+                    } else if (gain > 0) {
+                        allowed = partWeight[a] - w >= minWeight;
+                    } else {
+                        allowed = gain == 0 && partWeight[b] + w < partWeight[a];
+                    }
+                    if (allowed && (best < 0 || gain > bestGain)) {
+                        best = b;
+                        bestGain = gain;
+                    }
+                }
+                if (best >= 0 && contiguity &&
+                    !contiguity_removal_ok(contiguity, level->part, v)) {
+                    best = -1;
+                }
+                if (best >= 0) {
+                    if (contiguity) contiguity_moved(contiguity, a, best);
+                    level->part[v] = best;
+                    partWeight[a] -= w;
+                    partWeight[best] += w;
+                    moves++;
+                }
+            }
+
+            for (int t = 0; t < touchedCount; t++) {
+                conn[touched[t]] = 0;
+            }
+        }
+        if (moves == 0) break;
+    }
+
+    free(conn);
+    free(touched);
+    return 1;
+}
+
+/* Merge every fragment of a part other than its largest into the
+   neighboring part it shares the most edges with */
+static int repair_fragments(MlLevel* level, int parts) {
+    int n = level->n;
+    int* comp = (int*)malloc(sizeof(int) * (n > 0 ? n : 1));
+    int* queue = (int*)malloc(sizeof(int) * (n > 0 ? n : 1));
+    long* compWeight = (long*)malloc(sizeof(long) * (n > 0 ? n : 1));
+    int* compSize = (int*)malloc(sizeof(int) * (n > 0 ? n : 1));
+    int* largest = (int*)malloc(sizeof(int) * parts);
+    long* conn = (long*)calloc(parts, sizeof(long));
+    if (!comp || !queue || !compWeight || !compSize || !largest || !conn) {
+        free(comp);
+        free(queue);
+        free(compWeight);
+        free(compSize);
+        free(largest);
+        free(conn);
+        return 0;
+    }
+
+    /* Two rounds: a merge can join pieces that then need another look */
+    for (int round = 0; round < 2; round++) {
+        int comps = 0;
+        for (int v = 0; v < n; v++) {
+            comp[v] = -1;
+        }
+        for (int p = 0; p < parts; p++) {
+            largest[p] = -1;
+        }
+
+        for (int s = 0; s < n; s++) {
+            if (comp[s] >= 0) continue;
+            int p = level->part[s];
+            int head = 0, tail = 0;
+            queue[tail++] = s;
+            comp[s] = comps;
+            compWeight[comps] = 0;
+            while (head < tail) {
+                int v = queue[head++];
+                compWeight[comps] += level->vwgt[v];
+                for (int k = level->xadj[v]; k < level->xadj[v + 1]; k++) {
+                    int w = level->adj[k];
+                    if (comp[w] < 0 && level->part[w] == p) {
+                        comp[w] = comps;
+                        queue[tail++] = w;
+                    }
+                }
+            }
+            compSize[comps] = tail;
+            if (largest[p] < 0 || compSize[comps] > compSize[largest[p]]) largest[p] = comps;
+            comps++;
+        }
+        if (comps == parts) break;
+
+        /* Walk each fragment again from a member and pick its new part */
+        int merged = 0;
+        char* done = (char*)calloc(comps, 1);
+        if (!done) break;
+        for (int s = 0; s < n; s++) {
+            int c = comp[s];
+            int p = level->part[s];
+            if (done[c] || largest[p] == c) continue;
+            done[c] = 1;
+
+            int head = 0, tail = 0;
+            queue[tail++] = s;
+            int best = -1;
+            long bestConn = 0;
+            int* members = queue;
+            /* comp[] doubles as the visited mark: -2 once queued */
+            comp[s] = -2;
+            while (head < tail) {
+                int v = members[head++];
+                for (int k = level->xadj[v]; k < level->xadj[v + 1]; k++) {
+                    int w = level->adj[k];
+                    if (comp[w] == c) {
+                        comp[w] = -2;
+                        members[tail++] = w;
+                    } else if (level->part[w] != p) {
+                        conn[level->part[w]] += edge_weight(level, k);
+                        if (best < 0 || conn[level->part[w]] > bestConn) {
+                            best = level->part[w];
+                            bestConn = conn[best];
+                        }
+                    }
+                }
+            }
+            for (int k = 0; k < tail; k++) {
+                int v = members[k];
+                if (best >= 0) level->part[v] = best;
+                comp[v] = c;
+            }
+            for (int q = 0; q < parts; q++) {
+                conn[q] = 0;
+            }
+            if (best >= 0) merged++;
+        }
+        free(done);
+        if (merged == 0) break;
+    }
+
+    free(comp);
+    free(queue);
+    free(compWeight);
+    free(compSize);
+    free(largest);
+    free(conn);
+    return 1;
+}
+
+/* Partition every precinct into numDistricts balanced, contiguous parts;
+   writes districts 1..numDistricts into district[] */
+int multilevel_partition(const AppState* app, int numDistricts, int* district, uint32_t seed,
+                         int verbose) {
+    int n = app->precinctCount;
+    if (n == 0 || numDistricts < 1) return 0;
+
+    int levelCapacity = 64;
+    MlLevel* levels = (MlLevel*)calloc(levelCapacity, sizeof(MlLevel));
+    if (!levels) return 0;
+
+    MlLevel* base = &levels[0];
+    base->n = n;
+    base->xadj = app->adjacency.offsets;
+    base->adj = app->adjacency.neighbors;
+    base->vwgt = app->population;
+    base->owned = 0;
+
+    long total = 0;
+    for (int i = 0; i < n; i++) {
+        total += app->population[i];
+    }
+
+    double started = monotonic_seconds();
+    uint32_t rng = random_seed(seed, 0);
+    int coarsest = numDistricts * MULTILEVEL_COARSEST_PER_DISTRICT;
+    /* Cap coarse vertex weight so no vertex outweighs a fraction of a district */
+    int maxWeight = (int)(1.5 * total / (coarsest > 0 ? coarsest : 1)) + 1;
+    int depth = 0;
+    int ok = 1;
+
+    while (levels[depth].n > coarsest && depth + 1 < levelCapacity) {
+        if (!coarsen_level(&levels[depth], &levels[depth + 1], maxWeight, &rng)) {
+            ok = 0;
+            break;
+        }
+        depth++;
+        if (levels[depth].n > levels[depth - 1].n * MULTILEVEL_MIN_SHRINK) break;
+    }
+
+    long partWeight[MAX_DISTRICTS];
+    if (ok) {
+        MlLevel* top = &levels[depth];
+        ok = initial_partition(top, numDistricts, total);
+        if (verbose && ok) {
+            printf("Coarsened %d precincts to %d vertices over %d levels\n", n, top->n, depth);
+        }
+    }
+
+    /* Project down and refine, loosening balance where coarse vertices are
+       heavy. At the finest level, fragments are merged first and refinement
+       then keeps every part in one piece. */
+    ContiguityChecker contiguity;
+    memset(&contiguity, 0, sizeof(contiguity));
+    for (int level = depth; level >= 0 && ok; level--) {
+        MlLevel* cur = &levels[level];
+        if (level < depth) {
+            MlLevel* coarse = &levels[level + 1];
+            cur->part = (int*)malloc(sizeof(int) * cur->n);
+            if (!cur->part) {
+                ok = 0;
+                break;
+            }
+            for (int v = 0; v < cur->n; v++) {
+                cur->part[v] = coarse->part[cur->cmap[v]];
+            }
+        }
+
+        if (level == 0) {
+            ok = repair_fragments(cur, numDistricts) && contiguity_init(&contiguity, app);
+            if (!ok) break;
+        }
+
+        memset(partWeight, 0, sizeof(partWeight));
+        int heaviest = 0;
+        for (int v = 0; v < cur->n; v++) {
+            partWeight[cur->part[v]] += cur->vwgt[v];
+            if (cur->vwgt[v] > heaviest) heaviest = cur->vwgt[v];
+        }
+        double target = (double)total / numDistricts;
+        double tolerance = MULTILEVEL_BALANCE;
+        if (target > 0 && heaviest / target > tolerance) tolerance = heaviest / target;
+        ok = refine_level(cur, numDistricts, partWeight, tolerance, total,
+                          level == 0 ? &contiguity : NULL);
+    }
+    contiguity_free(&contiguity);
+
+    if (ok) {
+        for (int i = 0; i < n; i++) {
+            district[i] = base->part[i] + 1;
+        }
+        if (verbose) {
+            long cut = 0;
+            for (int v = 0; v < n; v++) {
+                for (int k = base->xadj[v]; k < base->xadj[v + 1]; k++) {
+                    if (base->part[base->adj[k]] != base->part[v]) cut++;
+                }
+            }
+            printf("Partitioned into %d districts in %.2f s, %ld boundary edges\n",
+                   numDistricts, monotonic_seconds() - started, cut / 2);
+        }
+    }
+
+    for (int level = 0; level <= depth; level++) {
+        free_level(&levels[level]);
+    }
+    free(levels);
+    return ok;
+}
@@ -0,0 +1,283 @@
+/*
+ * US Redistricting Tool - Binary Plan Files
+ *
+ * Plans are saved as <planId>.plan in the state's plans directory. JSON
+ * plans keyed by precinct id remain available for import and export.
+ *
+ * File layout (native byte order):
+ *   PlanFileHeader
+ *   uint64_t[wordCount]    district numbers in precinct order, bitsPerDistrict
+ *                          bits each, packed from the low bit of each word
+ *
+ * The header records a hash of the precinct ids in load order. A plan is
+ * only loaded against a state whose precinct ordering hashes the same, so
+ * the packed array can be unpacked by index without any id lookups. A
+ * second hash covers the packed words to catch truncated or damaged files.
+ */
+
+#include "../include/maps.h"
+
+#define PLAN_MAGIC "PLANBIN"
+#define PLAN_VERSION 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t bitsPerDistrict;
+    char state[8];
+    char planId[MAX_ID_LEN];
+    char name[MAX_NAME_LEN];
+    char lastUpdated[32];
+    uint32_t numDistricts;
+    uint32_t precinctCount;
+    uint64_t orderHash;        /* Precinct ids in load order */
+    uint64_t wordCount;
+    uint64_t dataHash;         /* Packed district words */
+} PlanFileHeader;
+
+/* Hash of the loaded precinct ids in order */
+static uint64_t precinct_order_hash(const AppState* app) {
+    uint64_t h = hash_bytes(&app->precinctCount, sizeof(app->precinctCount), 0);
+    for (int i = 0; i < app->precinctCount; i++) {
+        const char* id = app->precincts[i].id;
+        h = hash_bytes(id, strlen(id) + 1, h);
+    }
+    return h;
+}
+
+/* Bits needed for every district number in the assignment */
+/* Bits needed to store district numbers 0..maxDistrict */
+static uint32_t bits_for_district(int maxDistrict) {
+    uint32_t bits = 1;
+    while (bits < 31 && (1 << bits) <= maxDistrict) bits++;
+    return bits;
+}
+
+static uint32_t district_bits(const int* district, int count) {
+    int maxDistrict = 0;
+    for (int i = 0; i < count; i++) {
+        if (district[i] > maxDistrict) maxDistrict = district[i];
+    }
+    return bits_for_district(maxDistrict);
+}
+
+static uint64_t packed_words(int count, uint32_t bits) {
+    return ((uint64_t)count * bits + 63) / 64;
+}
+
+/* District numbers packed bits apiece into wordCount words; NULL if out of memory */
+static uint64_t* pack_districts(const int* district, int count, uint32_t bits, uint64_t wordCount) {
+    uint64_t* words = (uint64_t*)calloc(wordCount > 0 ? wordCount : 1, sizeof(uint64_t));
+    if (!words) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        return NULL;
+    }
+    for (int i = 0; i < count; i++) {
+        uint64_t value = district[i] > 0 ? (uint64_t)district[i] : 0;
+        uint64_t bit = (uint64_t)i * bits;
+        uint64_t word = bit / 64;
+        uint32_t shift = (uint32_t)(bit % 64);
+        words[word] |= value << shift;
+        if (shift + bits > 64) {
+            words[word + 1] |= value >> (64 - shift);
+        }
+    }
+    return words;
+}
+
+/* Copy a header's descriptive fields into a listing */
+static void header_to_info(const PlanFileHeader* h, PlanListing* info) {
+    memset(info, 0, sizeof(PlanListing));
+    memcpy(info->planId, h->planId, sizeof(info->planId) - 1);
+    memcpy(info->name, h->name, sizeof(info->name) - 1);
+    memcpy(info->lastUpdated, h->lastUpdated, sizeof(info->lastUpdated) - 1);
+    info->numDistricts = (int32_t)h->numDistricts;
+    info->contentHash = h->dataHash;
+}
+
+/* Read just the header of a plan file, for listings; returns 0 if the file
+   is not a plan file of this version */
+int read_plan_info(const char* path, PlanListing* info) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return 0;
+    }
+    PlanFileHeader h;
+    int ok = fread(&h, sizeof(h), 1, file) == 1 &&
+             memcmp(h.magic, PLAN_MAGIC, sizeof(h.magic)) == 0 &&
+             h.version == PLAN_VERSION;
+    fclose(file);
+    if (ok) {
+        header_to_info(&h, info);
+    }
+    return ok;
+}
+
+/* Nonzero if the plan file at path holds exactly this assignment */
+int plan_file_matches(const AppState* app, const char* path, const int* district) {
+    PlanListing info;
+    if (!read_plan_info(path, &info)) {
+        return 0;
+    }
+    uint32_t bits = district_bits(district, app->precinctCount);
+    uint64_t wordCount = packed_words(app->precinctCount, bits);
+    uint64_t* words = pack_districts(district, app->precinctCount, bits, wordCount);
+    if (!words) {
+        return 0;
+    }
+    uint64_t hash = hash_bytes(words, wordCount * sizeof(uint64_t), 0);
+    free(words);
+    return hash == info.contentHash;
+}
+
+/* Write an assignment as a plan file at path; contentHash (optional)
+   receives the hash of the packed districts. Reads only precinct ids from
+   app, so it can run while the working plan changes. */
+int write_plan_file(const AppState* app, const Plan* plan, const int* district, const char* path,
+                    uint64_t* contentHash) {
+    int n = app->precinctCount;
+    /* Readers reject such files, so never write one */
+    for (int i = 0; i < n; i++) {
+        if (district[i] < 0 || district[i] > plan->numDistricts) {
+            fprintf(stderr, "Plan assigns precinct %s to district %d of %d; not saving %s\n",
+                    app->precincts[i].id, district[i], plan->numDistricts, path);
+            return 0;
+        }
+    }
+    PlanFileHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, PLAN_MAGIC, sizeof(h.magic));
+    h.version = PLAN_VERSION;
+    h.bitsPerDistrict = district_bits(district, n);
+    /* Header fields are as wide as the Plan's, so copy them whole */
+    memcpy(h.state, plan->state, sizeof(h.state));
+    memcpy(h.planId, plan->planId, sizeof(h.planId));
+    memcpy(h.name, plan->name, sizeof(h.name));
+    memcpy(h.lastUpdated, plan->lastUpdated, sizeof(h.lastUpdated));
+    h.state[sizeof(h.state) - 1] = '\0';
+    h.planId[sizeof(h.planId) - 1] = '\0';
+    h.name[sizeof(h.name) - 1] = '\0';
+    h.lastUpdated[sizeof(h.lastUpdated) - 1] = '\0';
+    h.numDistricts = (uint32_t)plan->numDistricts;
+    h.precinctCount = (uint32_t)n;
+    h.orderHash = precinct_order_hash(app);
+    h.wordCount = packed_words(n, h.bitsPerDistrict);
+
+    uint64_t* words = pack_districts(district, n, h.bitsPerDistrict, h.wordCount);
+    if (!words) {
+        return 0;
+    }
+    h.dataHash = hash_bytes(words, h.wordCount * sizeof(uint64_t), 0);
+
+    int ok = 0;
+    FILE* file = fopen(path, "wb");
+    if (file) {
+        ok = fwrite(&h, sizeof(h), 1, file) == 1 &&
+             fwrite(words, sizeof(uint64_t), h.wordCount, file) == h.wordCount &&
+             sync_file(file);
+        ok = (fclose(file) == 0) && ok;
+    }
+    free(words);
+    if (ok && contentHash) {
+        *contentHash = h.dataHash;
+    }
+    return ok;
+}
+
+/* Write the current plan as a binary plan file, replacing any old file
+   only once the new one is complete */
+int save_plan_binary(AppState* app, const char* path) {
+    char tempPath[MAX_PATH_LEN + 8];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+    get_timestamp(app->currentPlan.lastUpdated, sizeof(app->currentPlan.lastUpdated));
+
+    int ok = write_plan_file(app, &app->currentPlan, app->district, tempPath, NULL);
+    if (ok) {
+        ok = replace_file(tempPath, path);
+    }
+    if (!ok) {
+        remove(tempPath);
+        fprintf(stderr, "Could not write plan file: %s\n", path);
+    }
+    return ok;
+}
+
+/* District of precinct i in packed words */
+static uint32_t unpack_district(const uint64_t* words, int i, uint32_t bits) {
+    uint64_t bit = (uint64_t)i * bits;
+    uint64_t word = bit / 64;
+    uint32_t shift = (uint32_t)(bit % 64);
+    uint64_t value = words[word] >> shift;
+    if (shift + bits > 64) {
+        value |= words[word + 1] << (64 - shift);
+    }
+    return (uint32_t)(value & (((uint64_t)1 << bits) - 1));
+}
+
+/* Unpack a binary plan file saved against the loaded precinct ordering
+   into district[]; info (optional) receives the header fields */
+int read_plan_assignment(const AppState* app, const char* path, int* district, PlanListing* info) {
+    MappedFile map;
+    if (!map_file(path, &map)) {
+        fprintf(stderr, "Could not read plan file: %s\n", path);
+        return 0;
+    }
+
+    const PlanFileHeader* h = (const PlanFileHeader*)map.data;
+    int valid = map.size >= sizeof(PlanFileHeader) &&
+                memcmp(h->magic, PLAN_MAGIC, sizeof(h->magic)) == 0 &&
+                h->version == PLAN_VERSION &&
+                h->numDistricts <= MAX_DISTRICTS &&
+                h->bitsPerDistrict >= 1 && h->bitsPerDistrict <= bits_for_district((int)h->numDistricts) &&
+                h->wordCount == packed_words((int)h->precinctCount, h->bitsPerDistrict) &&
+                map.size == sizeof(PlanFileHeader) + h->wordCount * sizeof(uint64_t);
+    const uint64_t* words = (const uint64_t*)(map.data + sizeof(PlanFileHeader));
+    if (!valid || hash_bytes(words, h->wordCount * sizeof(uint64_t), 0) != h->dataHash) {
+        fprintf(stderr, "Plan file is not a valid plan or is damaged: %s\n", path);
+        unmap_file(&map);
+        return 0;
+    }
+    if (h->precinctCount != (uint32_t)app->precinctCount || h->orderHash != precinct_order_hash(app)) {
+        fprintf(stderr, "Plan file was saved for different precinct data: %s\n", path);
+        fprintf(stderr, "Re-import it from a JSON export instead.\n");
+        unmap_file(&map);
+        return 0;
+    }
+
+    /* Check every value before touching district[], which may be the
+       working plan */
+    uint32_t bits = h->bitsPerDistrict;
+    for (int i = 0; i < app->precinctCount; i++) {
+        if (unpack_district(words, i, bits) > h->numDistricts) {
+            fprintf(stderr, "Plan file assigns a district past %u: %s\n", h->numDistricts, path);
+            unmap_file(&map);
+            return 0;
+        }
+    }
+    for (int i = 0; i < app->precinctCount; i++) {
+        district[i] = (int)unpack_district(words, i, bits);
+    }
+
+    if (info) {
+        header_to_info(h, info);
+    }
+    unmap_file(&map);
+    return 1;
+}
+
+/* Load a binary plan file as the current plan */
+int load_plan_binary(AppState* app, const char* path) {
+    PlanListing info;
+    if (!read_plan_assignment(app, path, app->district, &info)) {
+        return 0;
+    }
+
+    memset(&app->currentPlan, 0, sizeof(Plan));
+    strncpy(app->currentPlan.state, app->currentState->abbr, sizeof(app->currentPlan.state) - 1);
+    memcpy(app->currentPlan.planId, info.planId, sizeof(app->currentPlan.planId));
+    memcpy(app->currentPlan.name, info.name, sizeof(app->currentPlan.name));
+    memcpy(app->currentPlan.lastUpdated, info.lastUpdated, sizeof(app->currentPlan.lastUpdated));
+    app->currentPlan.numDistricts = info.numDistricts;
+    app->hasPlan = 1;
+    return sync_ledger(app);
+}
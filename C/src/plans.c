@@ -3,134 +3,59 @@
  */
 
 #include "../include/maps.h"
-#include "../lib/cJSON.h"
 
 #ifdef _WIN32
-#include <io.h>
-#include <direct.h>
+#include <process.h>
+#define getpid _getpid
 #else
-#include <dirent.h>
+#include <unistd.h>
 #endif
 
 /* External functions */
 extern char* read_file(const char* path);
-extern int write_file(const char* path, const char* content);
 
-/* Load list of saved plans for a state */
+/* stdio buffer for streaming JSON plan exports */
+#define PLAN_JSON_BUFFER (64 * 1024)
+
+/* Load list of saved plans for a state from its plan manifest */
 int load_plans_list(AppState* app, const char* stateCode) {
-    char plansDir[MAX_PATH_LEN];
-    snprintf(plansDir, sizeof(plansDir), "%s" PATH_SEP "plans" PATH_SEP "%s",
-             app->dataDir, stateCode);
-    
-    app->planCount = 0;
+    return refresh_plan_manifest(app, stateCode, 0);
+}
+
+/* Load a specific plan: the binary file if there is one, else JSON */
+int load_plan(AppState* app, const char* stateCode, const char* planId) {
+    char planPath[MAX_PATH_LEN];
+    snprintf(planPath, sizeof(planPath), "%s" PATH_SEP "plans" PATH_SEP "%s" PATH_SEP "%s.plan",
+             app->dataDir, stateCode, planId);
     
-    if (!file_exists(plansDir)) {
-        return 0;
+    int result;
+    if (file_exists(planPath)) {
+        printf("Loading plan from: %s\n", planPath);
+        result = load_plan_binary(app, planPath);
+        if (result) {
+            journal_open(app, 0);
+        }
+    } else {
+        snprintf(planPath, sizeof(planPath), "%s" PATH_SEP "plans" PATH_SEP "%s" PATH_SEP "%s.json",
+                 app->dataDir, stateCode, planId);
+        result = import_plan_json(app, planPath);
     }
     
-#ifdef _WIN32
-    WIN32_FIND_DATA findData;
-    char searchPath[MAX_PATH_LEN];
-    snprintf(searchPath, sizeof(searchPath), "%s" PATH_SEP "*.json", plansDir);
-    
-    HANDLE hFind = FindFirstFile(searchPath, &findData);
-    if (hFind != INVALID_HANDLE_VALUE) {
-        do {
-            if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
-                if (app->planCount >= MAX_PLANS) break;
-                
-                char planPath[MAX_PATH_LEN];
-                snprintf(planPath, sizeof(planPath), "%s" PATH_SEP "%s", plansDir, findData.cFileName);
-                
-                char* jsonStr = read_file(planPath);
-                if (jsonStr) {
-                    cJSON* root = cJSON_Parse(jsonStr);
-                    if (root) {
-                        cJSON* planId = cJSON_GetObjectItem(root, "planId");
-                        cJSON* name = cJSON_GetObjectItem(root, "name");
-                        
-                        if (planId && cJSON_IsString(planId)) {
-                            strncpy(app->planIds[app->planCount], planId->valuestring, MAX_ID_LEN - 1);
-                        } else {
-                            /* Use filename without extension */
-                            char* dot = strrchr(findData.cFileName, '.');
-                            if (dot) *dot = '\0';
-                            strncpy(app->planIds[app->planCount], findData.cFileName, MAX_ID_LEN - 1);
-                        }
-                        
-                        if (name && cJSON_IsString(name)) {
-                            strncpy(app->planNames[app->planCount], name->valuestring, MAX_NAME_LEN - 1);
-                        } else {
-                            strncpy(app->planNames[app->planCount], "(untitled)", MAX_NAME_LEN - 1);
-                        }
-                        
-                        app->planCount++;
-                        cJSON_Delete(root);
-                    }
-                    free(jsonStr);
-                }
-            }
-        } while (FindNextFile(hFind, &findData));
-        FindClose(hFind);
-    }
-#else
-    DIR* dir = opendir(plansDir);
-    if (dir) {
-        struct dirent* entry;
-        while ((entry = readdir(dir)) != NULL) {
-            if (app->planCount >= MAX_PLANS) break;
-            
-            char* ext = strrchr(entry->d_name, '.');
-            if (ext && strcmp(ext, ".json") == 0) {
-                char planPath[MAX_PATH_LEN];
-                snprintf(planPath, sizeof(planPath), "%s" PATH_SEP "%s", plansDir, entry->d_name);
-                
-                char* jsonStr = read_file(planPath);
-                if (jsonStr) {
-                    cJSON* root = cJSON_Parse(jsonStr);
-                    if (root) {
-                        cJSON* planId = cJSON_GetObjectItem(root, "planId");
-                        cJSON* name = cJSON_GetObjectItem(root, "name");
-                        
-                        if (planId && cJSON_IsString(planId)) {
-                            strncpy(app->planIds[app->planCount], planId->valuestring, MAX_ID_LEN - 1);
-                        } else {
-                            char filename[MAX_ID_LEN];
-                            strncpy(filename, entry->d_name, MAX_ID_LEN - 1);
-                            char* dot = strrchr(filename, '.');
-                            if (dot) *dot = '\0';
-                            strncpy(app->planIds[app->planCount], filename, MAX_ID_LEN - 1);
-                        }
-                        
-                        if (name && cJSON_IsString(name)) {
-                            strncpy(app->planNames[app->planCount], name->valuestring, MAX_NAME_LEN - 1);
-                        } else {
-                            strncpy(app->planNames[app->planCount], "(untitled)", MAX_NAME_LEN - 1);
-                        }
-                        
-                        app->planCount++;
-                        cJSON_Delete(root);
-                    }
-                    free(jsonStr);
-                }
-            }
-        }
-        closedir(dir);
+    if (result) {
+        printf("Loaded plan: %s\n", app->currentPlan.name);
+        printf("Districts: %d\n", app->currentPlan.numDistricts);
+        printf("Assigned precincts: %d / %d\n",
+               app->precinctCount - app->ledger.precinctCount[0], app->precinctCount);
     }
-#endif
     
-    return app->planCount;
+    return result;
 }
 
-/* Load a specific plan */
-int load_plan(AppState* app, const char* stateCode, const char* planId) {
-    char planPath[MAX_PATH_LEN];
-    snprintf(planPath, sizeof(planPath), "%s" PATH_SEP "plans" PATH_SEP "%s" PATH_SEP "%s.json",
-             app->dataDir, stateCode, planId);
-    
-    printf("Loading plan from: %s\n", planPath);
+/* Load a plan from a JSON file keyed by precinct id */
+int import_plan_json(AppState* app, const char* path) {
+    printf("Loading plan from: %s\n", path);
     
-    char* jsonStr = read_file(planPath);
+    char* jsonStr = read_file(path);
     if (!jsonStr) {
         fprintf(stderr, "Could not read plan file.\n");
         return 0;
@@ -138,25 +63,53 @@ int load_plan(AppState* app, const char* stateCode, const char* planId) {
     
     int result = parse_plan_json(app, jsonStr);
     free(jsonStr);
-    
-    if (result) {
-        printf("Loaded plan: %s\n", app->currentPlan.name);
-        printf("Districts: %d\n", app->currentPlan.numDistricts);
-        
-        /* Count assigned precincts */
-        int assigned = 0;
-        for (int i = 0; i < app->precinctCount; i++) {
-            if (app->precincts[i].district > 0) {
-                assigned++;
-            }
-        }
-        printf("Assigned precincts: %d / %d\n", assigned, app->precinctCount);
-    }
-    
     return result;
 }
 
-/* Save current plan to file */
+/* Write the current plan as JSON keyed by precinct id. The JSON streams
+   into a temp file that is synced and renamed over path only once
+   complete, so a crash never leaves a truncated plan behind. */
+int export_plan_json(AppState* app, const char* path) {
+    char tempPath[MAX_PATH_LEN + 8];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+    
+    int ok = 0;
+    FILE* file = fopen(tempPath, "wb");
+    if (file) {
+        setvbuf(file, NULL, _IOFBF, PLAN_JSON_BUFFER);
+        ok = write_plan_json(app, file) && sync_file(file);
+        ok = (fclose(file) == 0) && ok;
+    }
+    if (ok) {
+        ok = replace_file(tempPath, path);
+    }
+    if (!ok) {
+        remove(tempPath);
+        fprintf(stderr, "Could not write plan file: %s\n", path);
+    }
+    return ok;
+}
+
+/* A plan id no other save can produce: the time alone repeats for plans
+   made in the same second, so add the process id and a per-run counter */
+static void new_plan_id(char* out, size_t size) {
+    static int counter = 0;
+    snprintf(out, size, "plan_%ld_%lu_%d", (long)time(NULL), (unsigned long)getpid(), ++counter);
+}
+
+/* Nonzero if the current state's plans directory has a plan with this id */
+int saved_plan_exists(AppState* app, const char* planId) {
+    static const char* extensions[] = { "plan", "json" };
+    for (int e = 0; e < 2; e++) {
+        char path[MAX_PATH_LEN];
+        int len = snprintf(path, sizeof(path), "%s" PATH_SEP "plans" PATH_SEP "%s" PATH_SEP "%s.%s",
+                           app->dataDir, app->currentPlan.state, planId, extensions[e]);
+        if (len > 0 && len < (int)sizeof(path) && file_exists(path)) return 1;
+    }
+    return 0;
+}
+
+/* Save current plan to the state's plans directory */
 int save_plan(AppState* app) {
     if (!app->currentState) {
         fprintf(stderr, "No state loaded.\n");
@@ -180,31 +133,23 @@ int save_plan(AppState* app) {
     
     /* Generate plan ID if not set */
     if (app->currentPlan.planId[0] == '\0') {
-        snprintf(app->currentPlan.planId, sizeof(app->currentPlan.planId), 
-                 "plan_%ld", (long)time(NULL));
-    }
-    
-    /* Create JSON */
-    char* jsonStr = create_plan_json(app);
-    if (!jsonStr) {
-        fprintf(stderr, "Failed to create plan JSON.\n");
-        return 0;
+        new_plan_id(app->currentPlan.planId, sizeof(app->currentPlan.planId));
     }
     
-    /* Write to file */
     char planPath[MAX_PATH_LEN];
-    snprintf(planPath, sizeof(planPath), "%s" PATH_SEP "%s.json", 
+    snprintf(planPath, sizeof(planPath), "%s" PATH_SEP "%s.plan", 
              statePlansDir, app->currentPlan.planId);
     
     printf("Saving plan to: %s\n", planPath);
     
-    int result = write_file(planPath, jsonStr);
-    free(jsonStr);
+    /* A background compaction must not rename its snapshot over this save */
+    journal_cancel_compaction(app);
+    int result = save_plan_binary(app, planPath);
     
     if (result) {
         printf("Plan saved successfully!\n");
-        /* Reload plans list */
-        load_plans_list(app, app->currentPlan.state);
+        journal_rebase(app);
+        record_saved_plan(app, planPath);
     } else {
         fprintf(stderr, "Failed to save plan.\n");
     }
@@ -222,7 +167,7 @@ void create_new_plan(AppState* app, const char* name) {
     memset(&app->currentPlan, 0, sizeof(Plan));
     
     strncpy(app->currentPlan.state, app->currentState->abbr, sizeof(app->currentPlan.state) - 1);
-    snprintf(app->currentPlan.planId, sizeof(app->currentPlan.planId), "plan_%ld", (long)time(NULL));
+    new_plan_id(app->currentPlan.planId, sizeof(app->currentPlan.planId));
     
     if (name && name[0]) {
         strncpy(app->currentPlan.name, name, sizeof(app->currentPlan.name) - 1);
@@ -233,9 +178,7 @@ void create_new_plan(AppState* app, const char* name) {
     app->currentPlan.numDistricts = app->currentState->defaultNumDistricts;
     
     /* Reset all district assignments */
-    for (int i = 0; i < app->precinctCount; i++) {
-        app->precincts[i].district = 0;
-    }
+    clear_assignments(app);
     
     app->hasPlan = 1;
     
@@ -243,19 +186,42 @@ void create_new_plan(AppState* app, const char* name) {
     printf("Districts: %d\n", app->currentPlan.numDistricts);
 }
 
+/* Whether a listing is a JSON export of a plan that also has a binary file */
+static int listing_shadowed(const AppState* app, int index) {
+    const PlanListing* listing = &app->plans[index];
+    const char* ext = strrchr(listing->fileName, '.');
+    if (!ext || strcmp(ext, ".json") != 0) return 0;
+    for (int i = 0; i < app->planCount; i++) {
+        const char* other = strrchr(app->plans[i].fileName, '.');
+        if (i != index && other && strcmp(other, ".plan") == 0 &&
+            strcmp(app->plans[i].planId, listing->planId) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 /* Print list of saved plans */
 void print_plans_list(AppState* app) {
     printf("\n=== Saved Plans ===\n");
     if (app->planCount == 0) {
         printf("No saved plans for this state.\n");
     } else {
-        printf("%-4s %-20s %s\n", "#", "Plan ID", "Name");
-        printf("%-4s %-20s %s\n", "---", "--------------------", "--------------------");
+        printf("%-4s %-20s %-24s %5s %-19s %6s %8s\n",
+               "#", "Plan ID", "Name", "Dists", "Last Updated", "Dem", "EG");
+        printf("%-4s %-20s %-24s %5s %-19s %6s %8s\n", "---", "--------------------",
+               "------------------------", "-----", "-------------------", "------", "--------");
+        int shown = 0;
         for (int i = 0; i < app->planCount; i++) {
-            printf("%-4d %-20s %s\n", 
-                   i + 1,
-                   app->planIds[i],
-                   app->planNames[i]);
+            const PlanListing* p = &app->plans[i];
+            if (listing_shadowed(app, i)) continue;
+            printf("%-4d %-20s %-24.24s %5d %-19s ", ++shown, p->planId, p->name,
+                   p->numDistricts, p->lastUpdated[0] ? p->lastUpdated : "-");
+            if (p->hasSummary) {
+                printf("%6d %+7.2f%%\n", p->summary.demSeats, p->summary.efficiencyGap);
+            } else {
+                printf("%6s %8s\n", "-", "-");
+            }
         }
     }
     printf("\n");
@@ -0,0 +1,410 @@
+/*
+ * US Redistricting Tool - ReCom Ensemble Sampler
+ *
+ * Recombination Markov chain over district plans. Each step picks a random
+ * edge between two districts, merges the districts, draws a uniform
+ * spanning tree of the merged region (Wilson's algorithm) and cuts one tree
+ * edge whose two sides both fall within the population window. When a tree
+ * has no such edge a few more trees are drawn; if none balance, the chain
+ * stays put for that step.
+ *
+ * The merged region is the connected piece of the two districts around the
+ * chosen edge. For contiguous plans that is both districts whole; plans
+ * with detached pieces (whole-county automap output, islands) keep those
+ * pieces where they are and count them toward their district's population.
+ *
+ * The chain starts from the current plan and runs on its own copy of the
+ * assignment, so the working plan is left as it was. Sampled plans are
+ * streamed to a CSV file as they are drawn: a header row of precinct ids,
+ * then one row of district numbers per recorded step. Memory use does not
+ * grow with the number of steps.
+ */
+
+#include "../include/maps.h"
+
+/* Spanning trees drawn per step before the step is rejected */
+#define RECOM_TREE_ATTEMPTS 8
+
+/* Random precinct/neighbor draws used to find a district boundary edge */
+#define RECOM_PAIR_ATTEMPTS 4096
+
+/* Output buffer size for the sample stream */
+#define RECOM_STREAM_BUFFER (1 << 20)
+
+void recom_free(RecomChain* chain) {
+    free(chain->district);
+    ledger_free(&chain->ledger);
+    free(chain->local);
+    free(chain->nodes);
+    free(chain->parent);
+    free(chain->next);
+    free(chain->inTree);
+    free(chain->order);
+    free(chain->childStart);
+    free(chain->children);
+    free(chain->subPop);
+    free(chain->cuts);
+    free(chain->side);
+}
+
+/* Start a chain from the current plan; chains seeded alike but with
+   different streams draw independent sequences */
+int recom_init(RecomChain* chain, const AppState* app, double tolerance, uint32_t seed,
+               uint32_t stream) {
+    int n = app->precinctCount;
+    memset(chain, 0, sizeof(RecomChain));
+    chain->app = app;
+    chain->numDistricts = app->currentPlan.numDistricts;
+    chain->tolerance = tolerance;
+    chain->rng = random_seed(seed, stream);
+
+    long totalPop = 0;
+    for (int i = 0; i < n; i++) {
+        totalPop += app->population[i];
+    }
+    chain->idealPop = (int)(totalPop / chain->numDistricts);
+
+    chain->district = (int*)malloc(sizeof(int) * n);
+    chain->local = (int*)malloc(sizeof(int) * n);
+    chain->nodes = (int*)malloc(sizeof(int) * n);
+    chain->parent = (int*)malloc(sizeof(int) * n);
+    chain->next = (int*)malloc(sizeof(int) * n);
+    chain->inTree = (char*)malloc(n);
+    chain->order = (int*)malloc(sizeof(int) * n);
+    chain->childStart = (int*)malloc(sizeof(int) * (n + 1));
+    chain->children = (int*)malloc(sizeof(int) * n);
+    chain->subPop = (int*)malloc(sizeof(int) * n);
+    chain->cuts = (int*)malloc(sizeof(int) * n * 2);
+    chain->side = (char*)malloc(n);
+    if (!chain->district || !chain->local || !chain->nodes || !chain->parent || !chain->next ||
+        !chain->inTree || !chain->order || !chain->childStart || !chain->children ||
+        !chain->subPop || !chain->cuts || !chain->side) {
+        return 0;
+    }
+
+    memcpy(chain->district, app->district, sizeof(int) * n);
+    for (int i = 0; i < n; i++) {
+        chain->local[i] = -1;
+    }
+    return ledger_rebuild(&chain->ledger, app, chain->district);
+}
+
+/* Pick two adjacent districts by drawing random graph edges until one
+   crosses a district boundary; start is the precinct on district a's side */
+static int pick_district_pair(RecomChain* chain, int* start, int* a, int* b) {
+    const AdjacencyGraph* g = &chain->app->adjacency;
+    int n = chain->app->precinctCount;
+
+    for (int attempt = 0; attempt < RECOM_PAIR_ATTEMPTS; attempt++) {
+        int p = (int)random_below(&chain->rng, (uint32_t)n);
+        int degree = g->offsets[p + 1] - g->offsets[p];
+        if (degree == 0) continue;
+        int q = g->neighbors[g->offsets[p] + (int)random_below(&chain->rng, (uint32_t)degree)];
+        if (chain->district[p] != chain->district[q]) {
+            *start = p;
+            *a = chain->district[p];
+            *b = chain->district[q];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Random neighbor of a precinct inside the merged region, as a local index */
+static int random_region_neighbor(RecomChain* chain, int node) {
+    const AdjacencyGraph* g = &chain->app->adjacency;
+    int p = chain->nodes[node];
+    int start = g->offsets[p];
+    int degree = g->offsets[p + 1] - start;
+
+    /* Connected regions give every node at least one neighbor inside */
+    for (;;) {
+        int q = g->neighbors[start + (int)random_below(&chain->rng, (uint32_t)degree)];
+        if (chain->local[q] >= 0) return chain->local[q];
+    }
+}
+
+/* Collect the connected piece of districts a and b around a precinct,
+   numbering it locally; returns its size */
+static int collect_region(RecomChain* chain, int start, int a, int b) {
+    const AdjacencyGraph* g = &chain->app->adjacency;
+    int size = 0;
+    chain->local[start] = size;
+    chain->nodes[size++] = start;
+
+    for (int head = 0; head < size; head++) {
+        int p = chain->nodes[head];
+        for (int k = g->offsets[p]; k < g->offsets[p + 1]; k++) {
+            int q = g->neighbors[k];
+            if (chain->local[q] < 0 && (chain->district[q] == a || chain->district[q] == b)) {
+                chain->local[q] = size;
+                chain->nodes[size++] = q;
+            }
+        }
+    }
+    return size;
+}
+
+/* Uniform spanning tree of the region by loop-erased random walks */
+static void draw_spanning_tree(RecomChain* chain, int size) {
+    memset(chain->inTree, 0, size);
+    int root = (int)random_below(&chain->rng, (uint32_t)size);
+    chain->inTree[root] = 1;
+    chain->parent[root] = -1;
+
+    for (int i = 0; i < size; i++) {
+        /* Walk until the tree is hit; later visits overwrite next[], which
+           erases the loops */
+        int u = i;
+        while (!chain->inTree[u]) {
+            chain->next[u] = random_region_neighbor(chain, u);
+            u = chain->next[u];
+        }
+        u = i;
+        while (!chain->inTree[u]) {
+            chain->inTree[u] = 1;
+            chain->parent[u] = chain->next[u];
+            u = chain->next[u];
+        }
+    }
+
+    /* Root-first order through child lists, then subtree populations */
+    memset(chain->childStart, 0, sizeof(int) * (size + 1));
+    for (int v = 0; v < size; v++) {
+        if (chain->parent[v] >= 0) chain->childStart[chain->parent[v] + 1]++;
+    }
+    for (int v = 0; v < size; v++) {
+        chain->childStart[v + 1] += chain->childStart[v];
+    }
+    int* cursor = chain->subPop;
+    memcpy(cursor, chain->childStart, sizeof(int) * size);
+    for (int v = 0; v < size; v++) {
+        if (chain->parent[v] >= 0) chain->children[cursor[chain->parent[v]]++] = v;
+    }
+
+    int head = 0, tail = 0;
+    chain->order[tail++] = root;
+    while (head < tail) {
+        int v = chain->order[head++];
+        for (int k = chain->childStart[v]; k < chain->childStart[v + 1]; k++) {
+            chain->order[tail++] = chain->children[k];
+        }
+    }
+
+    for (int v = 0; v < size; v++) {
+        chain->subPop[v] = chain->app->population[chain->nodes[v]];
+    }
+    for (int k = size - 1; k > 0; k--) {
+        int v = chain->order[k];
+        chain->subPop[chain->parent[v]] += chain->subPop[v];
+    }
+}
+
+/* One chain step; returns 1 if the plan changed */
+int recom_step(RecomChain* chain) {
+    const AppState* app = chain->app;
+    const DistrictLedger* ledger = &chain->ledger;
+    int start, a, b;
+    if (!pick_district_pair(chain, &start, &a, &b)) {
+        chain->noPair++;
+        return 0;
+    }
+
+    int size = collect_region(chain, start, a, b);
+    int regionPop = 0;
+    int regionA = 0;
+    for (int v = 0; v < size; v++) {
+        int p = chain->nodes[v];
+        regionPop += app->population[p];
+        if (chain->district[p] == a) regionA += app->population[p];
+    }
+    if (size < ledger->precinctCount[a] + ledger->precinctCount[b]) {
+        chain->partialMerges++;
+    }
+
+    /* Population district a keeps outside the region */
+    int restA = ledger->population[a] - regionA;
+    int total = ledger->population[a] + ledger->population[b];
+    double lo = chain->idealPop * (1 - chain->tolerance);
+    double hi = chain->idealPop * (1 + chain->tolerance);
+    if (total < 2 * lo || total > 2 * hi) {
+        /* The pair cannot meet the window; split it as evenly as the
+           tolerance allows so the chain can work back toward balance */
+        lo = total / 2.0 - chain->idealPop * chain->tolerance;
+        hi = total / 2.0 + chain->idealPop * chain->tolerance;
+    }
+
+    int cutCount = 0;
+    for (int attempt = 0; attempt < RECOM_TREE_ATTEMPTS && cutCount == 0 && size > 1; attempt++) {
+        draw_spanning_tree(chain, size);
+        for (int v = 0; v < size; v++) {
+            if (chain->parent[v] < 0) continue;
+            /* Either side of the cut can go to district a */
+            for (int flip = 0; flip < 2; flip++) {
+                int popA = restA + (flip ? regionPop - chain->subPop[v] : chain->subPop[v]);
+                int popB = total - popA;
+                if (popA >= lo && popA <= hi && popB >= lo && popB <= hi) {
+                    chain->cuts[cutCount++] = v * 2 + flip;
+                }
+            }
+        }
+    }
+
+    int changed = 0;
+    if (cutCount == 0) {
+        chain->noBalancedCut++;
+    } else {
+        int pick = chain->cuts[random_below(&chain->rng, (uint32_t)cutCount)];
+        int cut = pick / 2;
+        int flip = pick % 2;
+
+        /* Mark the cut subtree, then give one side to a and the other to b */
+        for (int k = 0; k < size; k++) {
+            int v = chain->order[k];
+            chain->side[v] = v == cut ? 1 : (chain->parent[v] >= 0 ? chain->side[chain->parent[v]] : 0);
+        }
+        for (int v = 0; v < size; v++) {
+            int p = chain->nodes[v];
+            int d = chain->side[v] != flip ? a : b;
+            if (chain->district[p] != d) {
+                ledger_move(&chain->ledger, app, p, chain->district[p], d);
+                chain->district[p] = d;
+            }
+        }
+        chain->accepted++;
+        changed = 1;
+    }
+
+    for (int v = 0; v < size; v++) {
+        chain->local[chain->nodes[v]] = -1;
+    }
+    return changed;
+}
+
+/* Append one sampled plan to the stream */
+static int write_sample(const RecomChain* chain, char* row, FILE* out, long step) {
+    char* s = row;
+    s += sprintf(s, "%ld", step);
+    for (int i = 0; i < chain->app->precinctCount; i++) {
+        int d = chain->district[i];
+        *s++ = ',';
+        if (d >= 100) *s++ = (char)('0' + d / 100);
+        if (d >= 10) *s++ = (char)('0' + (d / 10) % 10);
+        *s++ = (char)('0' + d % 10);
+    }
+    *s++ = '\n';
+    size_t len = (size_t)(s - row);
+    return fwrite(row, 1, len, out) == len;
+}
+
+/* Whether the current plan can seed a chain: every precinct assigned and
+   every district populated */
+int recom_plan_ready(const AppState* app) {
+    if (!app->currentState || app->precinctCount == 0 || !app->hasPlan) {
+        fprintf(stderr, "Load a state and create or load a plan first.\n");
+        return 0;
+    }
+    int numDistricts = app->currentPlan.numDistricts;
+    if (numDistricts < 2) {
+        fprintf(stderr, "ReCom needs a plan with at least 2 districts.\n");
+        return 0;
+    }
+    if (app->ledger.precinctCount[0] > 0) {
+        fprintf(stderr, "ReCom needs every precinct assigned (%d unassigned).\n",
+                app->ledger.precinctCount[0]);
+        return 0;
+    }
+    for (int d = 1; d <= numDistricts; d++) {
+        if (app->ledger.precinctCount[d] == 0) {
+            fprintf(stderr, "ReCom needs every district populated (district %d is empty).\n", d);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Run a ReCom chain from the current plan and stream samples to a CSV file */
+int run_recom_chain(AppState* app, int steps, double tolerance, int recordEvery,
+                    uint32_t seed, const char* outputPath) {
+    if (!recom_plan_ready(app)) return 0;
+    int numDistricts = app->currentPlan.numDistricts;
+    if (recordEvery < 1) recordEvery = 1;
+
+    RecomChain chain;
+    /* Up to three digits and a comma per precinct, plus the step column */
+    char* row = (char*)malloc((size_t)app->precinctCount * 4 + 32);
+    if (!recom_init(&chain, app, tolerance, seed, 0) || !row) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        recom_free(&chain);
+        free(row);
+        return 0;
+    }
+
+    FILE* out = fopen(outputPath, "wb");
+    if (!out) {
+        fprintf(stderr, "Cannot open output file: %s\n", outputPath);
+        recom_free(&chain);
+        free(row);
+        return 0;
+    }
+    setvbuf(out, NULL, _IOFBF, RECOM_STREAM_BUFFER);
+
+    printf("\n=== ReCom Ensemble Sampler ===\n");
+    printf("Districts: %d, ideal population %d (±%.1f%%)\n",
+           numDistricts, chain.idealPop, tolerance * 100);
+    printf("Steps: %d, recording every %d, seed %u\n", steps, recordEvery, seed);
+    printf("Output: %s\n", outputPath);
+
+    /* Header row, then the seed plan as step 0 */
+    int ok = fputs("step", out) >= 0;
+    for (int i = 0; i < app->precinctCount && ok; i++) {
+        ok = fputc(',', out) != EOF && fputs(app->precincts[i].id, out) >= 0;
+    }
+    ok = ok && fputc('\n', out) != EOF && write_sample(&chain, row, out, 0);
+
+    long recorded = 1;
+    double started = monotonic_seconds();
+    double lastReport = started;
+    for (int step = 1; step <= steps && ok; step++) {
+        recom_step(&chain);
+        if (step % recordEvery == 0) {
+            ok = write_sample(&chain, row, out, step);
+            recorded++;
+        }
+
+        double now = monotonic_seconds();
+        if (now - lastReport >= 1.0) {
+            printf("  step %d/%d (%.0f steps/s)\n", step, steps, step / (now - started));
+            fflush(stdout);
+            lastReport = now;
+        }
+    }
+    double elapsed = monotonic_seconds() - started;
+
+    if (fclose(out) != 0) ok = 0;
+    if (!ok) {
+        fprintf(stderr, "Error writing samples to %s\n", outputPath);
+    } else {
+        printf("\nChain complete: %d steps in %.2f s (%.0f steps/s)\n",
+               steps, elapsed, elapsed > 0 ? steps / elapsed : 0.0);
+        printf("  Accepted:           %ld (%.1f%%)\n", chain.accepted,
+               steps > 0 ? 100.0 * chain.accepted / steps : 0.0);
+        printf("  No balanced cut:    %ld\n", chain.noBalancedCut);
+        printf("  Partial merges:     %ld\n", chain.partialMerges);
+        if (chain.noPair > 0) {
+            printf("  No district pair:   %ld\n", chain.noPair);
+        }
+        printf("  Plans recorded:     %ld\n", recorded);
+
+        int maxDev = 0;
+        for (int d = 1; d <= numDistricts; d++) {
+            int dev = abs(chain.ledger.population[d] - chain.idealPop);
+            if (dev > maxDev) maxDev = dev;
+        }
+        printf("  Final max deviation: %.2f%%\n", 100.0 * maxDev / chain.idealPop);
+    }
+
+    recom_free(&chain);
+    free(row);
+    return ok;
+}
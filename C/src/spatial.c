@@ -0,0 +1,309 @@
+/*
+ * US Redistricting Tool - Spatial Index
+ *
+ * A uniform grid over the loaded state's extent, built once per state. Cells
+ * are sized so that each holds about SPATIAL_ITEMS_PER_CELL centroids. Two
+ * bucket lists are kept in CSR form: precincts by the cell containing their
+ * centroid (radius and nearest-neighbor queries), and precincts by every
+ * cell their bounding box overlaps (box and point-in-box queries). Precincts
+ * whose box spans more than SPATIAL_MAX_BOX_CELLS cells are kept on a short
+ * side list instead of being copied into every cell.
+ *
+ * Queries allocate nothing and keep no per-query state in the index, so one
+ * index can be shared by several threads.
+ */
+
+#include "../include/maps.h"
+
+#define SPATIAL_ITEMS_PER_CELL 2.0
+#define SPATIAL_MAX_BOX_CELLS 64
+
+static int cell_col(const SpatialIndex* idx, double x) {
+    int c = (int)floor((x - idx->minX) / idx->cellSize);
+    if (c < 0) return 0;
+    if (c >= idx->cols) return idx->cols - 1;
+    return c;
+}
+
+static int cell_row(const SpatialIndex* idx, double y) {
+    int r = (int)floor((y - idx->minY) / idx->cellSize);
+    if (r < 0) return 0;
+    if (r >= idx->rows) return idx->rows - 1;
+    return r;
+}
+
+static int box_cell_count(const SpatialIndex* idx, const BoundingBox* b) {
+    return (cell_col(idx, b->maxX) - cell_col(idx, b->minX) + 1) *
+           (cell_row(idx, b->maxY) - cell_row(idx, b->minY) + 1);
+}
+
+/* Release the index's arrays */
+void free_spatial_index(SpatialIndex* idx) {
+    free(idx->cellStart);
+    free(idx->items);
+    free(idx->boxStart);
+    free(idx->boxItems);
+    free(idx->largeItems);
+    memset(idx, 0, sizeof(SpatialIndex));
+}
+
+/* Build the grid over the currently loaded precincts */
+int build_spatial_index(SpatialIndex* idx, const AppState* app) {
+    free_spatial_index(idx);
+
+    int n = app->precinctCount;
+    if (n == 0) return 1;
+
+    double minX = 1e300, minY = 1e300, maxX = -1e300, maxY = -1e300;
+    for (int i = 0; i < n; i++) {
+        const BoundingBox* b = &app->precincts[i].bounds;
+        if (b->minX < minX) minX = b->minX;
+        if (b->minY < minY) minY = b->minY;
+        if (b->maxX > maxX) maxX = b->maxX;
+        if (b->maxY > maxY) maxY = b->maxY;
+    }
+
+    double width = maxX - minX;
+    double height = maxY - minY;
+    double extent = width > height ? width : height;
+    if (extent <= 0) extent = 1.0;
+
+    /* Aim for a few centroids per cell, with at least a 1x1 grid */
+    double cellSize = sqrt((width > 0 ? width : extent) * (height > 0 ? height : extent) *
+                           SPATIAL_ITEMS_PER_CELL / n);
+    if (cellSize <= 0 || cellSize > extent) cellSize = extent;
+
+    idx->minX = minX;
+    idx->minY = minY;
+    idx->cellSize = cellSize;
+    idx->cols = (int)(width / cellSize) + 1;
+    idx->rows = (int)(height / cellSize) + 1;
+    idx->count = n;
+
+    int cells = idx->cols * idx->rows;
+    idx->cellStart = (int*)calloc(cells + 1, sizeof(int));
+    idx->boxStart = (int*)calloc(cells + 1, sizeof(int));
+    idx->items = (int*)malloc(sizeof(int) * n);
+    if (!idx->cellStart || !idx->boxStart || !idx->items) {
+        free_spatial_index(idx);
+        return 0;
+    }
+
+    /* Count per cell */
+    int boxTotal = 0;
+    for (int i = 0; i < n; i++) {
+        const Precinct* p = &app->precincts[i];
+        idx->cellStart[cell_row(idx, p->centroid.y) * idx->cols + cell_col(idx, p->centroid.x) + 1]++;
+
+        if (box_cell_count(idx, &p->bounds) > SPATIAL_MAX_BOX_CELLS) {
+            idx->largeCount++;
+            continue;
+        }
+        for (int r = cell_row(idx, p->bounds.minY); r <= cell_row(idx, p->bounds.maxY); r++) {
+            for (int c = cell_col(idx, p->bounds.minX); c <= cell_col(idx, p->bounds.maxX); c++) {
+                idx->boxStart[r * idx->cols + c + 1]++;
+                boxTotal++;
+            }
+        }
+    }
+
+    for (int c = 0; c < cells; c++) {
+        idx->cellStart[c + 1] += idx->cellStart[c];
+        idx->boxStart[c + 1] += idx->boxStart[c];
+    }
+
+    idx->boxItems = (int*)malloc(sizeof(int) * (boxTotal > 0 ? boxTotal : 1));
+    idx->largeItems = (int*)malloc(sizeof(int) * (idx->largeCount > 0 ? idx->largeCount : 1));
+    int* cursor = (int*)malloc(sizeof(int) * cells);
+    int* boxCursor = (int*)malloc(sizeof(int) * cells);
+    if (!idx->boxItems || !idx->largeItems || !cursor || !boxCursor) {
+        free(cursor);
+        free(boxCursor);
+        free_spatial_index(idx);
+        return 0;
+    }
+    memcpy(cursor, idx->cellStart, sizeof(int) * cells);
+    memcpy(boxCursor, idx->boxStart, sizeof(int) * cells);
+
+    /* Scatter */
+    int large = 0;
+    for (int i = 0; i < n; i++) {
+        const Precinct* p = &app->precincts[i];
+        idx->items[cursor[cell_row(idx, p->centroid.y) * idx->cols + cell_col(idx, p->centroid.x)]++] = i;
+
+        if (box_cell_count(idx, &p->bounds) > SPATIAL_MAX_BOX_CELLS) {
+            idx->largeItems[large++] = i;
+            continue;
+        }
+        for (int r = cell_row(idx, p->bounds.minY); r <= cell_row(idx, p->bounds.maxY); r++) {
+            for (int c = cell_col(idx, p->bounds.minX); c <= cell_col(idx, p->bounds.maxX); c++) {
+                idx->boxItems[boxCursor[r * idx->cols + c]++] = i;
+            }
+        }
+    }
+
+    free(cursor);
+    free(boxCursor);
+    return 1;
+}
+
+/* Precincts whose centroid lies within radius of (x, y); returns total found */
+int spatial_query_radius(const SpatialIndex* idx, const AppState* app, double x, double y,
+                         double radius, int* out, int maxOut) {
+    if (idx->count == 0) return 0;
+
+    int found = 0;
+    double r2 = radius * radius;
+    int r0 = cell_row(idx, y - radius), r1 = cell_row(idx, y + radius);
+    int c0 = cell_col(idx, x - radius), c1 = cell_col(idx, x + radius);
+
+    for (int r = r0; r <= r1; r++) {
+        for (int c = c0; c <= c1; c++) {
+            int cell = r * idx->cols + c;
+            for (int k = idx->cellStart[cell]; k < idx->cellStart[cell + 1]; k++) {
+                int i = idx->items[k];
+                double dx = app->precincts[i].centroid.x - x;
+                double dy = app->precincts[i].centroid.y - y;
+                if (dx * dx + dy * dy <= r2) {
+                    if (found < maxOut) out[found] = i;
+                    found++;
+                }
+            }
+        }
+    }
+    return found;
+}
+
+/* Insert candidate into the sorted best-k list */
+static void knn_insert(int* out, double* dist, int* count, int k, int i, double d) {
+    if (*count == k && d >= dist[k - 1]) return;
+    int pos = *count < k ? (*count)++ : k - 1;
+    while (pos > 0 && dist[pos - 1] > d) {
+        out[pos] = out[pos - 1];
+        dist[pos] = dist[pos - 1];
+        pos--;
+    }
+    out[pos] = i;
+    dist[pos] = d;
+}
+
+/*
+ * The k precincts with centroids nearest to (x, y), nearest first, skipping
+ * any the filter rejects. Searches outward ring by ring and stops once no
+ * unvisited cell can hold anything closer. Returns the number found.
+ */
+int spatial_k_nearest(const SpatialIndex* idx, const AppState* app, double x, double y, int k,
+                      SpatialFilter filter, void* ctx, int* out, double* outDist) {
+    if (idx->count == 0 || k <= 0) return 0;
+
+    int count = 0;
+    int qc = cell_col(idx, x);
+    int qr = cell_row(idx, y);
+    int maxRing = idx->cols > idx->rows ? idx->cols : idx->rows;
+
+    for (int ring = 0; ring <= maxRing; ring++) {
+        /* Every cell on this ring or beyond lies outside the block of cells
+           already searched; stop once that block's edge is farther than the
+           k-th best. Queries outside the grid only prune once covered. */
+        if (count == k && ring > 0) {
+            double x0 = idx->minX + (qc - ring + 1) * idx->cellSize;
+            double x1 = idx->minX + (qc + ring) * idx->cellSize;
+            double y0 = idx->minY + (qr - ring + 1) * idx->cellSize;
+            double y1 = idx->minY + (qr + ring) * idx->cellSize;
+            if (x >= x0 && x <= x1 && y >= y0 && y <= y1) {
+                double reach = x - x0;
+                if (x1 - x < reach) reach = x1 - x;
+                if (y - y0 < reach) reach = y - y0;
+                if (y1 - y < reach) reach = y1 - y;
+                if (reach * reach > outDist[k - 1]) break;
+            }
+        }
+
+        for (int r = qr - ring; r <= qr + ring; r++) {
+            if (r < 0 || r >= idx->rows) continue;
+            int onEdge = (r == qr - ring || r == qr + ring);
+            int step = onEdge ? 1 : 2 * ring;
+            for (int c = qc - ring; c <= qc + ring; c += (step > 0 ? step : 1)) {
+                if (c < 0 || c >= idx->cols) continue;
+                int cell = r * idx->cols + c;
+                for (int m = idx->cellStart[cell]; m < idx->cellStart[cell + 1]; m++) {
+                    int i = idx->items[m];
+                    if (filter && !filter(i, ctx)) continue;
+                    double dx = app->precincts[i].centroid.x - x;
+                    double dy = app->precincts[i].centroid.y - y;
+                    knn_insert(out, outDist, &count, k, i, dx * dx + dy * dy);
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        outDist[i] = sqrt(outDist[i]);
+    }
+    return count;
+}
+
+static int box_overlaps(const BoundingBox* a, const BoundingBox* b) {
+    return a->minX <= b->maxX && a->maxX >= b->minX &&
+           a->minY <= b->maxY && a->maxY >= b->minY;
+}
+
+/* Precincts whose bounding box intersects the query box; returns total found */
+int spatial_query_box(const SpatialIndex* idx, const AppState* app, const BoundingBox* box,
+                      int* out, int maxOut) {
+    if (idx->count == 0) return 0;
+
+    int found = 0;
+    int r0 = cell_row(idx, box->minY), r1 = cell_row(idx, box->maxY);
+    int c0 = cell_col(idx, box->minX), c1 = cell_col(idx, box->maxX);
+
+    for (int r = r0; r <= r1; r++) {
+        for (int c = c0; c <= c1; c++) {
+            int cell = r * idx->cols + c;
+            for (int k = idx->boxStart[cell]; k < idx->boxStart[cell + 1]; k++) {
+                int i = idx->boxItems[k];
+                const BoundingBox* b = &app->precincts[i].bounds;
+                if (!box_overlaps(b, box)) continue;
+
+                /* Report each precinct only from the first cell of the overlap */
+                double ox = b->minX > box->minX ? b->minX : box->minX;
+                double oy = b->minY > box->minY ? b->minY : box->minY;
+                if (cell_col(idx, ox) != c || cell_row(idx, oy) != r) continue;
+
+                if (found < maxOut) out[found] = i;
+                found++;
+            }
+        }
+    }
+
+    for (int k = 0; k < idx->largeCount; k++) {
+        int i = idx->largeItems[k];
+        if (box_overlaps(&app->precincts[i].bounds, box)) {
+            if (found < maxOut) out[found] = i;
+            found++;
+        }
+    }
+    return found;
+}
+
+/* Precinct containing (x, y) by bounding box, nearest centroid first; -1 if none */
+int spatial_locate(const SpatialIndex* idx, const AppState* app, double x, double y) {
+    int candidates[64];
+    BoundingBox query = { x, y, x, y };
+    int found = spatial_query_box(idx, app, &query, candidates, 64);
+    if (found > 64) found = 64;
+
+    int best = -1;
+    double bestDist = 0;
+    for (int k = 0; k < found; k++) {
+        const Precinct* p = &app->precincts[candidates[k]];
+        double dx = p->centroid.x - x;
+        double dy = p->centroid.y - y;
+        double d = dx * dx + dy * dy;
+        if (best < 0 || d < bestDist) {
+            best = candidates[k];
+            bestDist = d;
+        }
+    }
+    return best;
+}
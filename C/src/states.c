@@ -111,6 +111,170 @@ int load_states_list(AppState* app) {
     return app->stateCount;
 }
 
+/* Grow one hot column; the old block stays valid on failure */
+static int grow_column(int** column, int count) {
+    int* grown = (int*)realloc(*column, sizeof(int) * (size_t)count);
+    if (!grown) return 0;
+    *column = grown;
+    return 1;
+}
+
+/* Make room for at least count precincts, keeping existing records */
+int reserve_precincts(AppState* app, int count) {
+    if (count <= app->precinctCapacity) {
+        return 1;
+    }
+    
+    Precinct* grown = (Precinct*)realloc(app->precincts, sizeof(Precinct) * (size_t)count);
+    if (grown) {
+        app->precincts = grown;
+    }
+    if (!grown ||
+        !grow_column(&app->population, count) ||
+        !grow_column(&app->dem, count) ||
+        !grow_column(&app->rep, count) ||
+        !grow_column(&app->district, count) ||
+        !grow_column(&app->countyId, count)) {
+        fprintf(stderr, "Out of memory allocating %d precincts.\n", count);
+        return 0;
+    }
+    
+    app->precinctCapacity = count;
+    return 1;
+}
+
+/* Return the id for a county name, adding it if new; -1 when out of memory */
+int intern_county(CountyTable* table, const char* name) {
+    char key[MAX_NAME_LEN];
+    strncpy(key, name, MAX_NAME_LEN - 1);
+    key[MAX_NAME_LEN - 1] = '\0';
+    size_t keyLen = strlen(key);
+    
+    if (table->slotCount > 0) {
+        uint64_t h = hash_bytes(key, keyLen, 0);
+        int slot = (int)(h & (uint64_t)(table->slotCount - 1));
+        while (table->slots[slot] >= 0) {
+            if (strcmp(table->names[table->slots[slot]], key) == 0) {
+                return table->slots[slot];
+            }
+            slot = (slot + 1) & (table->slotCount - 1);
+        }
+    }
+    
+    if (table->count >= table->capacity) {
+        int newCap = table->capacity ? table->capacity * 2 : 64;
+        char (*names)[MAX_NAME_LEN] = (char (*)[MAX_NAME_LEN])realloc(table->names, (size_t)newCap * MAX_NAME_LEN);
+        if (!names) return -1;
+        table->names = names;
+        table->capacity = newCap;
+    }
+    
+    /* Keep the hash at most half full */
+    if ((table->count + 1) * 2 > table->slotCount) {
+        int slotCount = table->slotCount ? table->slotCount * 2 : 128;
+        int* slots = (int*)malloc(sizeof(int) * slotCount);
+        if (!slots) return -1;
+        memset(slots, -1, sizeof(int) * slotCount);
+        for (int id = 0; id < table->count; id++) {
+            uint64_t h = hash_bytes(table->names[id], strlen(table->names[id]), 0);
+            int slot = (int)(h & (uint64_t)(slotCount - 1));
+            while (slots[slot] >= 0) slot = (slot + 1) & (slotCount - 1);
+            slots[slot] = id;
+        }
+        free(table->slots);
+        table->slots = slots;
+        table->slotCount = slotCount;
+    }
+    
+    int id = table->count++;
+    strncpy(table->names[id], key, MAX_NAME_LEN); /* Zero-pads for the cache */
+    
+    uint64_t h = hash_bytes(key, keyLen, 0);
+    int slot = (int)(h & (uint64_t)(table->slotCount - 1));
+    while (table->slots[slot] >= 0) slot = (slot + 1) & (table->slotCount - 1);
+    table->slots[slot] = id;
+    return id;
+}
+
+void free_county_table(CountyTable* table) {
+    free(table->names);
+    free(table->slots);
+    memset(table, 0, sizeof(CountyTable));
+}
+
+/* Index every precinct id; with duplicate ids the first precinct wins */
+int build_precinct_id_index(AppState* app) {
+    free_precinct_id_index(&app->idIndex);
+    
+    int slotCount = 16;
+    while (slotCount < app->precinctCount * 2) slotCount *= 2;
+    int* slots = (int*)malloc(sizeof(int) * slotCount);
+    if (!slots) return 0;
+    memset(slots, -1, sizeof(int) * slotCount);
+    
+    for (int i = 0; i < app->precinctCount; i++) {
+        const char* id = app->precincts[i].id;
+        int slot = (int)(hash_bytes(id, strlen(id), 0) & (uint64_t)(slotCount - 1));
+        while (slots[slot] >= 0 && strcmp(app->precincts[slots[slot]].id, id) != 0) {
+            slot = (slot + 1) & (slotCount - 1);
+        }
+        if (slots[slot] < 0) {
+            slots[slot] = i;
+        }
+    }
+    
+    app->idIndex.slots = slots;
+    app->idIndex.slotCount = slotCount;
+    return 1;
+}
+
+void free_precinct_id_index(PrecinctIdIndex* index) {
+    free(index->slots);
+    index->slots = NULL;
+    index->slotCount = 0;
+}
+
+/* Precinct index for an id, or -1 if the loaded state has no such precinct */
+int find_precinct(const AppState* app, const char* id) {
+    const PrecinctIdIndex* index = &app->idIndex;
+    if (index->slotCount == 0) return -1;
+    
+    int slot = (int)(hash_bytes(id, strlen(id), 0) & (uint64_t)(index->slotCount - 1));
+    while (index->slots[slot] >= 0) {
+        if (strcmp(app->precincts[index->slots[slot]].id, id) == 0) {
+            return index->slots[slot];
+        }
+        slot = (slot + 1) & (index->slotCount - 1);
+    }
+    return -1;
+}
+
+/* Release the currently loaded state's precinct data */
+void unload_state_data(AppState* app) {
+    journal_close(app);
+    free_spatial_index(&app->spatial);
+    free_precinct_id_index(&app->idIndex);
+    ledger_free(&app->ledger);
+    contiguity_free(&app->contiguity);
+    free_adjacency_graph(&app->adjacency);
+    unmap_file(&app->cacheMap);
+    free(app->precincts);
+    free(app->population);
+    free(app->dem);
+    free(app->rep);
+    free(app->district);
+    free(app->countyId);
+    free_county_table(&app->counties);
+    app->precincts = NULL;
+    app->population = NULL;
+    app->dem = NULL;
+    app->rep = NULL;
+    app->district = NULL;
+    app->countyId = NULL;
+    app->precinctCount = 0;
+    app->precinctCapacity = 0;
+}
+
 /* Load precinct data for a specific state */
 int load_state_data(AppState* app, const char* stateCode) {
     char upperCode[8];
@@ -139,6 +303,8 @@ int load_state_data(AppState* app, const char* stateCode) {
         return 0;
     }
     
+    unload_state_data(app);
+    
     /* Load precincts.geojson */
     char geoPath[MAX_PATH_LEN];
     snprintf(geoPath, sizeof(geoPath), "%s" PATH_SEP "precincts" PATH_SEP "%s" PATH_SEP "precincts.geojson",
@@ -146,16 +312,36 @@ int load_state_data(AppState* app, const char* stateCode) {
     
     printf("Loading precinct data from: %s\n", geoPath);
     
-    char* jsonStr = read_file(geoPath);
-    if (!jsonStr) {
+    if (!file_exists(geoPath)) {
         fprintf(stderr, "Could not read precinct data file.\n");
         fprintf(stderr, "Please ensure precinct data exists at: %s\n", geoPath);
         return 0;
     }
     
-    printf("Parsing GeoJSON data...\n");
-    int result = parse_geojson(app, jsonStr);
-    free(jsonStr);
+    int result = load_precinct_cache(app, geoPath);
+    if (result) {
+        printf("Loaded precinct cache.\n");
+    } else {
+        printf("Parsing GeoJSON data...\n");
+        result = parse_geojson_file(app, geoPath);
+        if (result) {
+            save_precinct_cache(app, geoPath);
+        }
+    }
+    
+    if (result && !build_spatial_index(&app->spatial, app)) {
+        fprintf(stderr, "Out of memory building spatial index.\n");
+        result = 0;
+    }
+    
+    if (result && !build_precinct_id_index(app)) {
+        fprintf(stderr, "Out of memory building precinct id index.\n");
+        result = 0;
+    }
+    
+    if (result && !sync_ledger(app)) {
+        result = 0;
+    }
     
     if (result) {
         printf("Loaded %d precincts for %s (%s)\n", 
@@ -166,9 +352,9 @@ int load_state_data(AppState* app, const char* stateCode) {
         /* Calculate total population and votes */
         int totalPop = 0, totalDem = 0, totalRep = 0;
         for (int i = 0; i < app->precinctCount; i++) {
-            totalPop += app->precincts[i].population;
-            totalDem += app->precincts[i].dem;
-            totalRep += app->precincts[i].rep;
+            totalPop += app->population[i];
+            totalDem += app->dem[i];
+            totalRep += app->rep[i];
         }
         
         printf("Total population: %d\n", totalPop);
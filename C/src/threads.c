@@ -0,0 +1,173 @@
+/*
+ * US Redistricting Tool - Thread Pool
+ *
+ * parallel_for runs tasks 0 .. taskCount-1 on a set of worker threads.
+ * Workers claim the next task index from a shared atomic counter, so
+ * uneven tasks still keep every worker busy until the last one is taken.
+ * background_start runs a single task on its own thread while the caller
+ * carries on, for work such as rewriting files that the caller polls for
+ * and collects later.
+ * Threads are Win32 threads on Windows and pthreads elsewhere.
+ */
+
+#include "../include/maps.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+typedef struct {
+    ParallelTask fn;
+    void* ctx;
+    int taskCount;
+    volatile long nextTask;
+} ParallelJob;
+
+/* Claim the next task index */
+static int claim_task(ParallelJob* job) {
+#ifdef _WIN32
+    return (int)InterlockedIncrement(&job->nextTask) - 1;
+#else
+    return (int)__sync_fetch_and_add(&job->nextTask, 1);
+#endif
+}
+
+static void run_tasks(ParallelJob* job) {
+    for (;;) {
+        int task = claim_task(job);
+        if (task >= job->taskCount) break;
+        job->fn(task, job->ctx);
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI worker_main(LPVOID arg) {
+    run_tasks((ParallelJob*)arg);
+    return 0;
+}
+#else
+static void* worker_main(void* arg) {
+    run_tasks((ParallelJob*)arg);
+    return NULL;
+}
+#endif
+
+/* Number of logical processors, at least 1 */
+int cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+/* Run every task, using up to threadCount threads including the caller.
+   If threads cannot be started the caller runs the remaining tasks itself,
+   so every task always runs exactly once. */
+int parallel_for(int taskCount, int threadCount, ParallelTask fn, void* ctx) {
+    ParallelJob job;
+    job.fn = fn;
+    job.ctx = ctx;
+    job.taskCount = taskCount;
+    job.nextTask = 0;
+    
+    if (threadCount > taskCount) threadCount = taskCount;
+    int extra = threadCount > 1 ? threadCount - 1 : 0;
+    int started = 0;
+    
+#ifdef _WIN32
+    HANDLE* threads = extra ? (HANDLE*)malloc(sizeof(HANDLE) * extra) : NULL;
+    for (int t = 0; threads && t < extra; t++) {
+        threads[t] = CreateThread(NULL, 0, worker_main, &job, 0, NULL);
+        if (!threads[t]) break;
+        started++;
+    }
+    run_tasks(&job);
+    for (int t = 0; t < started; t++) {
+        WaitForSingleObject(threads[t], INFINITE);
+        CloseHandle(threads[t]);
+    }
+#else
+    pthread_t* threads = extra ? (pthread_t*)malloc(sizeof(pthread_t) * extra) : NULL;
+    for (int t = 0; threads && t < extra; t++) {
+        if (pthread_create(&threads[t], NULL, worker_main, &job) != 0) break;
+        started++;
+    }
+    run_tasks(&job);
+    for (int t = 0; t < started; t++) {
+        pthread_join(threads[t], NULL);
+    }
+#endif
+    
+    free(threads);
+    return started + 1;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI background_main(LPVOID arg) {
+    BackgroundTask* task = (BackgroundTask*)arg;
+    task->fn(0, task->ctx);
+    InterlockedExchange(&task->finished, 1);
+    return 0;
+}
+#else
+static void* background_main(void* arg) {
+    BackgroundTask* task = (BackgroundTask*)arg;
+    task->fn(0, task->ctx);
+    __sync_lock_test_and_set(&task->finished, 1);
+    return NULL;
+}
+#endif
+
+/* Start fn(0, ctx) on a background thread. If no thread can be started the
+   task runs to completion before this returns; either way the caller must
+   background_wait before reusing the task. */
+void background_start(BackgroundTask* task, ParallelTask fn, void* ctx) {
+    task->fn = fn;
+    task->ctx = ctx;
+    task->finished = 0;
+    task->thread = NULL;
+
+#ifdef _WIN32
+    HANDLE thread = CreateThread(NULL, 0, background_main, task, 0, NULL);
+    if (thread) {
+        task->thread = thread;
+        return;
+    }
+#else
+    pthread_t* thread = (pthread_t*)malloc(sizeof(pthread_t));
+    if (thread && pthread_create(thread, NULL, background_main, task) == 0) {
+        task->thread = thread;
+        return;
+    }
+    free(thread);
+#endif
+    fn(0, ctx);
+    task->finished = 1;
+}
+
+/* Nonzero once the task has returned */
+int background_finished(BackgroundTask* task) {
+#ifdef _WIN32
+    return InterlockedCompareExchange(&task->finished, 0, 0) != 0;
+#else
+    return __sync_fetch_and_add(&task->finished, 0) != 0;
+#endif
+}
+
+/* Wait for the task to return and release its thread */
+void background_wait(BackgroundTask* task) {
+    if (!task->thread) return;
+#ifdef _WIN32
+    WaitForSingleObject((HANDLE)task->thread, INFINITE);
+    CloseHandle((HANDLE)task->thread);
+#else
+    pthread_join(*(pthread_t*)task->thread, NULL);
+    free(task->thread);
+#endif
+    task->thread = NULL;
+}
@@ -0,0 +1,356 @@
+/*
+ * US Redistricting Tool - Topological Precinct Adjacency
+ *
+ * Two precincts are neighbors when their polygons share a boundary edge
+ * (rook adjacency) or, in queen mode, at least one vertex. Ring vertices are
+ * snapped to a fixed grid of TOPOLOGY_QUANTUM coordinate units and interned
+ * in a hash table; each ring edge is then keyed by its pair of vertex ids in
+ * a second table. An edge that is seen again from a different precinct
+ * yields a neighbor pair, so the whole pass is linear in the number of
+ * vertices read. This relies on neighboring polygons using the same vertices
+ * along their common boundary, as census-derived precinct files do.
+ *
+ * Shared boundary length is accumulated per pair in coordinate units when
+ * requested.
+ */
+
+#include "../include/maps.h"
+
+#define TOPOLOGY_QUANTUM 1e-7
+#define TOPOLOGY_EMPTY -1
+
+typedef struct {
+    int64_t x;
+    int64_t y;
+    int id;          /* Vertex id, TOPOLOGY_EMPTY if slot unused */
+    int owners;      /* Queen mode: head of owner chain */
+} VertexSlot;
+
+typedef struct {
+    uint64_t key;    /* (lowVertex << 32) | highVertex */
+    int precinct;    /* First precinct seen on this edge, TOPOLOGY_EMPTY if unused */
+} EdgeSlot;
+
+typedef struct {
+    int precinct;
+    int next;
+} VertexOwner;
+
+typedef struct {
+    int a;
+    int b;
+    double length;
+} NeighborPair;
+
+struct TopologyBuilder {
+    AdjacencyMode mode;
+    int recordLengths;
+
+    VertexSlot* vertices;
+    size_t vertexCap;
+    int vertexCount;
+
+    EdgeSlot* edges;
+    size_t edgeCap;
+    size_t edgeCount;
+
+    VertexOwner* owners;
+    size_t ownerCount;
+    size_t ownerCap;
+
+    NeighborPair* pairs;
+    size_t pairCount;
+    size_t pairCap;
+
+    int failed;
+};
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static int grow_vertices(TopologyBuilder* b) {
+    size_t newCap = b->vertexCap ? b->vertexCap * 2 : 4096;
+    VertexSlot* slots = (VertexSlot*)malloc(sizeof(VertexSlot) * newCap);
+    if (!slots) return 0;
+    for (size_t i = 0; i < newCap; i++) slots[i].id = TOPOLOGY_EMPTY;
+
+    for (size_t i = 0; i < b->vertexCap; i++) {
+        VertexSlot* v = &b->vertices[i];
+        if (v->id == TOPOLOGY_EMPTY) continue;
+        size_t s = mix64((uint64_t)v->x * 31 + (uint64_t)v->y) & (newCap - 1);
+        while (slots[s].id != TOPOLOGY_EMPTY) s = (s + 1) & (newCap - 1);
+        slots[s] = *v;
+    }
+
+    free(b->vertices);
+    b->vertices = slots;
+    b->vertexCap = newCap;
+    return 1;
+}
+
+static int grow_edges(TopologyBuilder* b) {
+    size_t newCap = b->edgeCap ? b->edgeCap * 2 : 4096;
+    EdgeSlot* slots = (EdgeSlot*)malloc(sizeof(EdgeSlot) * newCap);
+    if (!slots) return 0;
+    for (size_t i = 0; i < newCap; i++) slots[i].precinct = TOPOLOGY_EMPTY;
+
+    for (size_t i = 0; i < b->edgeCap; i++) {
+        EdgeSlot* e = &b->edges[i];
+        if (e->precinct == TOPOLOGY_EMPTY) continue;
+        size_t s = mix64(e->key) & (newCap - 1);
+        while (slots[s].precinct != TOPOLOGY_EMPTY) s = (s + 1) & (newCap - 1);
+        slots[s] = *e;
+    }
+
+    free(b->edges);
+    b->edges = slots;
+    b->edgeCap = newCap;
+    return 1;
+}
+
+static int add_pair(TopologyBuilder* b, int p, int q, double length) {
+    if (b->pairCount >= b->pairCap) {
+        size_t newCap = b->pairCap ? b->pairCap * 2 : 1024;
+        NeighborPair* grown = (NeighborPair*)realloc(b->pairs, sizeof(NeighborPair) * newCap);
+        if (!grown) return 0;
+        b->pairs = grown;
+        b->pairCap = newCap;
+    }
+    NeighborPair* pair = &b->pairs[b->pairCount++];
+    pair->a = p;
+    pair->b = q;
+    pair->length = length;
+    return 1;
+}
+
+/* Record that precinct touches vertex v, pairing it with earlier owners */
+static int add_vertex_owner(TopologyBuilder* b, VertexSlot* v, int precinct) {
+    for (int o = v->owners; o != TOPOLOGY_EMPTY; o = b->owners[o].next) {
+        if (b->owners[o].precinct == precinct) return 1;
+    }
+
+    for (int o = v->owners; o != TOPOLOGY_EMPTY; o = b->owners[o].next) {
+        if (!add_pair(b, b->owners[o].precinct, precinct, 0.0)) return 0;
+    }
+
+    if (b->ownerCount >= b->ownerCap) {
+        size_t newCap = b->ownerCap ? b->ownerCap * 2 : 4096;
+        VertexOwner* grown = (VertexOwner*)realloc(b->owners, sizeof(VertexOwner) * newCap);
+        if (!grown) return 0;
+        b->owners = grown;
+        b->ownerCap = newCap;
+    }
+    b->owners[b->ownerCount].precinct = precinct;
+    b->owners[b->ownerCount].next = v->owners;
+    v->owners = (int)b->ownerCount++;
+    return 1;
+}
+
+/* Intern a snapped vertex and return its id, or TOPOLOGY_EMPTY on failure */
+static int intern_vertex(TopologyBuilder* b, int64_t x, int64_t y, int precinct) {
+    if ((size_t)(b->vertexCount + 1) * 2 > b->vertexCap && !grow_vertices(b)) {
+        return TOPOLOGY_EMPTY;
+    }
+
+    size_t s = mix64((uint64_t)x * 31 + (uint64_t)y) & (b->vertexCap - 1);
+    while (b->vertices[s].id != TOPOLOGY_EMPTY) {
+        if (b->vertices[s].x == x && b->vertices[s].y == y) break;
+        s = (s + 1) & (b->vertexCap - 1);
+    }
+
+    VertexSlot* v = &b->vertices[s];
+    if (v->id == TOPOLOGY_EMPTY) {
+        v->x = x;
+        v->y = y;
+        v->id = b->vertexCount++;
+        v->owners = TOPOLOGY_EMPTY;
+    }
+
+    if (b->mode == ADJACENCY_QUEEN && !add_vertex_owner(b, v, precinct)) {
+        return TOPOLOGY_EMPTY;
+    }
+    return v->id;
+}
+
+/* Register one ring edge; pairs the precinct with whoever registered it first */
+static int add_edge(TopologyBuilder* b, int va, int vb, int precinct, double length) {
+    if (va == vb) return 1;
+    if (va > vb) {
+        int t = va;
+        va = vb;
+        vb = t;
+    }
+
+    if ((b->edgeCount + 1) * 2 > b->edgeCap && !grow_edges(b)) {
+        return 0;
+    }
+
+    uint64_t key = ((uint64_t)(uint32_t)va << 32) | (uint32_t)vb;
+    size_t s = mix64(key) & (b->edgeCap - 1);
+    while (b->edges[s].precinct != TOPOLOGY_EMPTY) {
+        if (b->edges[s].key == key) {
+            int other = b->edges[s].precinct;
+            if (other == precinct) return 1;
+            return add_pair(b, other, precinct, length);
+        }
+        s = (s + 1) & (b->edgeCap - 1);
+    }
+
+    b->edges[s].key = key;
+    b->edges[s].precinct = precinct;
+    b->edgeCount++;
+    return 1;
+}
+
+TopologyBuilder* topology_create(AdjacencyMode mode, int recordLengths) {
+    TopologyBuilder* b = (TopologyBuilder*)calloc(1, sizeof(TopologyBuilder));
+    if (!b) return NULL;
+    b->mode = mode;
+    b->recordLengths = recordLengths;
+    return b;
+}
+
+void topology_free(TopologyBuilder* b) {
+    if (!b) return;
+    free(b->vertices);
+    free(b->edges);
+    free(b->owners);
+    free(b->pairs);
+    free(b);
+}
+
+/* Add one polygon ring given as pointCount interleaved x,y coordinates */
+int topology_add_ring(TopologyBuilder* b, int precinct, const double* coords, int pointCount) {
+    if (b->failed) return 0;
+
+    int prev = TOPOLOGY_EMPTY;
+    double prevX = 0, prevY = 0;
+
+    for (int i = 0; i < pointCount; i++) {
+        double x = coords[2 * i];
+        double y = coords[2 * i + 1];
+        int v = intern_vertex(b, (int64_t)llround(x / TOPOLOGY_QUANTUM),
+                              (int64_t)llround(y / TOPOLOGY_QUANTUM), precinct);
+        if (v == TOPOLOGY_EMPTY) {
+            b->failed = 1;
+            return 0;
+        }
+
+        if (prev != TOPOLOGY_EMPTY) {
+            double length = 0;
+            if (b->recordLengths) {
+                double dx = x - prevX;
+                double dy = y - prevY;
+                length = sqrt(dx * dx + dy * dy);
+            }
+            if (!add_edge(b, prev, v, precinct, length)) {
+                b->failed = 1;
+                return 0;
+            }
+        }
+
+        prev = v;
+        prevX = x;
+        prevY = y;
+    }
+
+    return 1;
+}
+
+/* Turn the collected neighbor pairs into a symmetric, duplicate-free CSR graph */
+int topology_build(TopologyBuilder* b, int nodeCount, AdjacencyGraph* graph) {
+    memset(graph, 0, sizeof(AdjacencyGraph));
+    if (b->failed) return 0;
+
+    int* offsets = (int*)calloc(nodeCount + 1, sizeof(int));
+    int* cursor = (int*)malloc(sizeof(int) * (nodeCount > 0 ? nodeCount : 1));
+    int* lastRow = (int*)malloc(sizeof(int) * (nodeCount > 0 ? nodeCount : 1));
+    int* lastPos = (int*)malloc(sizeof(int) * (nodeCount > 0 ? nodeCount : 1));
+    size_t raw = b->pairCount * 2;
+    int* rawNeighbors = (int*)malloc(sizeof(int) * (raw > 0 ? raw : 1));
+    double* rawWeights = (double*)malloc(sizeof(double) * (raw > 0 ? raw : 1));
+
+    if (!offsets || !cursor || !lastRow || !lastPos || !rawNeighbors || !rawWeights) {
+        free(offsets);
+        free(cursor);
+        free(lastRow);
+        free(lastPos);
+        free(rawNeighbors);
+        free(rawWeights);
+        return 0;
+    }
+
+    /* Bucket both directions of every pair by source precinct */
+    for (size_t i = 0; i < b->pairCount; i++) {
+        offsets[b->pairs[i].a + 1]++;
+        offsets[b->pairs[i].b + 1]++;
+    }
+    for (int i = 0; i < nodeCount; i++) {
+        offsets[i + 1] += offsets[i];
+        cursor[i] = offsets[i];
+    }
+    for (size_t i = 0; i < b->pairCount; i++) {
+        NeighborPair* pair = &b->pairs[i];
+        rawNeighbors[cursor[pair->a]] = pair->b;
+        rawWeights[cursor[pair->a]++] = pair->length;
+        rawNeighbors[cursor[pair->b]] = pair->a;
+        rawWeights[cursor[pair->b]++] = pair->length;
+    }
+
+    /* Compact each row in place, merging repeated neighbors */
+    for (int i = 0; i < nodeCount; i++) lastRow[i] = -1;
+
+    int out = 0;
+    int rowStart = 0;
+    for (int i = 0; i < nodeCount; i++) {
+        int begin = rowStart;
+        rowStart = offsets[i + 1];
+        offsets[i] = out;
+        for (int k = begin; k < rowStart; k++) {
+            int n = rawNeighbors[k];
+            if (lastRow[n] == i) {
+                rawWeights[lastPos[n]] += rawWeights[k];
+                continue;
+            }
+            lastRow[n] = i;
+            lastPos[n] = out;
+            rawNeighbors[out] = n;
+            rawWeights[out] = rawWeights[k];
+            out++;
+        }
+    }
+    offsets[nodeCount] = out;
+
+    free(cursor);
+    free(lastRow);
+    free(lastPos);
+
+    graph->offsets = offsets;
+    graph->neighbors = (int*)realloc(rawNeighbors, sizeof(int) * (out > 0 ? out : 1));
+    if (!graph->neighbors) graph->neighbors = rawNeighbors;
+    if (b->recordLengths) {
+        graph->weights = (double*)realloc(rawWeights, sizeof(double) * (out > 0 ? out : 1));
+        if (!graph->weights) graph->weights = rawWeights;
+    } else {
+        free(rawWeights);
+    }
+    graph->nodeCount = nodeCount;
+    graph->edgeCount = out;
+    return 1;
+}
+
+/* Release a graph's arrays */
+void free_adjacency_graph(AdjacencyGraph* graph) {
+    if (!graph->borrowed) {
+        free(graph->offsets);
+        free(graph->neighbors);
+        free(graph->weights);
+    }
+    memset(graph, 0, sizeof(AdjacencyGraph));
+}
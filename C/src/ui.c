@@ -91,9 +91,9 @@ void show_state_menu(AppState* app) {
         
         int totalPop = 0, totalDem = 0, totalRep = 0;
         for (int i = 0; i < app->precinctCount; i++) {
-            totalPop += app->precincts[i].population;
-            totalDem += app->precincts[i].dem;
-            totalRep += app->precincts[i].rep;
+            totalPop += app->population[i];
+            totalDem += app->dem[i];
+            totalRep += app->rep[i];
         }
         printf("Total Population: %d\n", totalPop);
         printf("Total Dem Votes: %d\n", totalDem);
@@ -126,7 +126,7 @@ void show_plan_menu(AppState* app) {
         
         int assigned = 0;
         for (int i = 0; i < app->precinctCount; i++) {
-            if (app->precincts[i].district > 0) assigned++;
+            if (app->district[i] > 0) assigned++;
         }
         printf("Assigned Precincts: %d / %d\n", assigned, app->precinctCount);
     } else {
@@ -139,6 +139,9 @@ void show_plan_menu(AppState* app) {
     printf("  3. List saved plans\n");
     printf("  4. Load existing plan\n");
     printf("  5. Rename current plan\n");
+    printf("  6. Export current plan as JSON\n");
+    printf("  7. Import plan from JSON file\n");
+    printf("  8. Rebuild saved plan index\n");
     printf("  0. Back to main menu\n");
     printf("═════════════════════════════════════════\n");
 }
@@ -177,6 +180,9 @@ void show_automap_menu(AppState* app) {
     printf("  4. Lean Democratic (54%% D, 46%% R)\n");
     printf("  5. Very Democratic (60%% D, 40%% R)\n");
     printf("  6. Custom target percentage\n");
+    printf("\nEnsembles:\n");
+    printf("  7. ReCom sampler (starts from current plan)\n");
+    printf("  8. Ensemble analysis of current plan\n");
     printf("  0. Back to main menu\n");
     printf("═════════════════════════════════════════\n");
 }
@@ -240,7 +246,7 @@ void show_precinct_summary(AppState* app) {
     int districtCounts[MAX_DISTRICTS + 1] = {0};
     
     for (int i = 0; i < app->precinctCount; i++) {
-        int d = app->precincts[i].district;
+        int d = app->district[i];
         if (d <= 0) {
             unassigned++;
         } else if (d <= MAX_DISTRICTS) {
@@ -262,44 +268,42 @@ void show_precinct_summary(AppState* app) {
     /* Count by county */
     printf("\nBy County:\n");
     
-    typedef struct { char name[MAX_NAME_LEN]; int count; } CountyCount;
-    CountyCount counties[200];
-    int countyCount = 0;
-    
+    int countyCount = app->counties.count;
+    int* countyPrecincts = (int*)calloc(countyCount > 0 ? countyCount : 1, sizeof(int));
+    if (!countyPrecincts) {
+        printf("  (out of memory)\n");
+        return;
+    }
     for (int i = 0; i < app->precinctCount; i++) {
-        int found = 0;
-        for (int c = 0; c < countyCount; c++) {
-            if (strcmp(counties[c].name, app->precincts[i].county) == 0) {
-                counties[c].count++;
-                found = 1;
-                break;
-            }
-        }
-        if (!found && countyCount < 200) {
-            strncpy(counties[countyCount].name, app->precincts[i].county, MAX_NAME_LEN - 1);
-            counties[countyCount].count = 1;
-            countyCount++;
-        }
+        countyPrecincts[app->countyId[i]]++;
     }
     
     /* Show top 10 counties */
-    for (int i = 0; i < countyCount - 1; i++) {
-        for (int j = 0; j < countyCount - i - 1; j++) {
-            if (counties[j].count < counties[j + 1].count) {
-                CountyCount temp = counties[j];
-                counties[j] = counties[j + 1];
-                counties[j + 1] = temp;
-            }
+    int top[10];
+    int topCount = 0;
+    for (int c = 0; c < countyCount; c++) {
+        int pos = topCount < 10 ? topCount++ : 10;
+        while (pos > 0 && countyPrecincts[top[pos - 1]] < countyPrecincts[c]) {
+            if (pos < 10) top[pos] = top[pos - 1];
+            pos--;
         }
+        if (pos < 10) top[pos] = c;
     }
     
-    int showCount = countyCount < 10 ? countyCount : 10;
-    for (int i = 0; i < showCount; i++) {
-        printf("  %-20s %d precincts\n", counties[i].name, counties[i].count);
+    for (int i = 0; i < topCount; i++) {
+        printf("  %-20s %d precincts\n", app->counties.names[top[i]], countyPrecincts[top[i]]);
     }
     if (countyCount > 10) {
         printf("  ... and %d more counties\n", countyCount - 10);
     }
+    free(countyPrecincts);
+}
+
+/* A journal write failed: later records would follow a torn one and be
+   dropped on replay, so stop journaling and leave the edits to a save */
+static void stop_journaling(AppState* app) {
+    journal_close(app);
+    printf("Edits are no longer journaled; save the plan to keep them.\n");
 }
 
 /* Manual precinct assignment interface */
@@ -318,12 +322,29 @@ void show_manual_assignment(AppState* app) {
     printf("MANUAL PRECINCT ASSIGNMENT\n");
     printf("═════════════════════════════════════════\n");
     printf("Enter precinct ID and district number to assign.\n");
-    printf("Enter 'list' to show precincts, 'quit' to exit.\n");
+    printf("Enter 'list' to show precincts, 'undo'/'redo' to step through edits, 'quit' to exit.\n");
     printf("\n");
     
+    /* Edits go to the journal of the plan's saved file as they are made */
+    if (!journal_attach(app)) {
+        char confirm[16];
+        printf("This plan differs from its saved copy (or has none), so edits cannot be journaled.\n");
+        get_user_string("Save the plan now and journal edits? (y/N): ", confirm, sizeof(confirm));
+        if ((confirm[0] == 'y' || confirm[0] == 'Y') && save_plan(app) && journal_attach(app)) {
+            printf("Edits will be journaled.\n");
+        } else {
+            printf("Edits are not journaled; save the plan to keep them.\n");
+        }
+    }
+    
     char input[128];
     while (1) {
-        printf("Command (precinct_id district | list | search <term> | quit): ");
+        /* One disk sync per command */
+        if (!journal_sync(app)) {
+            stop_journaling(app);
+        }
+        
+        printf("Command (precinct_id district | list | search <term> | locate <x> <y> | undo | redo | quit): ");
         fflush(stdout);
         
         if (fgets(input, sizeof(input), stdin) == NULL) break;
@@ -336,6 +357,24 @@ void show_manual_assignment(AppState* app) {
             break;
         }
         
+        if (strcmp(input, "undo") == 0 || strcmp(input, "redo") == 0) {
+            JournalMove move;
+            int undo = input[0] == 'u';
+            int available = undo ? app->journal.undoCount : app->journal.redoCount;
+            if (!app->journal.file || available == 0) {
+                printf("Nothing to %s.\n", input);
+                continue;
+            }
+            int journaled = undo ? journal_undo(app, &move) : journal_redo(app, &move);
+            printf("%s precinct %s: district %d -> %d\n", undo ? "Undid" : "Redid",
+                   app->precincts[move.precinct].id,
+                   undo ? move.to : move.from, undo ? move.from : move.to);
+            if (!journaled) {
+                stop_journaling(app);
+            }
+            continue;
+        }
+        
         if (strcmp(input, "list") == 0) {
             printf("\nFirst 20 precincts:\n");
             printf("%-20s %-10s %-8s %-10s\n", "ID", "Pop", "Dem%", "District");
@@ -343,13 +382,32 @@ void show_manual_assignment(AppState* app) {
             for (int i = 0; i < app->precinctCount && shown < 20; i++) {
                 Precinct* p = &app->precincts[i];
                 printf("%-20s %-10d %-7.1f%% %d\n", 
-                       p->id, p->population, p->demShare * 100, p->district);
+                       p->id, app->population[i], p->demShare * 100, app->district[i]);
                 shown++;
             }
             printf("\n");
             continue;
         }
         
+        if (strncmp(input, "locate ", 7) == 0) {
+            double x, y;
+            if (sscanf(input + 7, "%lf %lf", &x, &y) != 2) {
+                printf("Usage: locate <longitude> <latitude>\n");
+                continue;
+            }
+            int i = spatial_locate(&app->spatial, app, x, y);
+            if (i < 0) {
+                printf("No precinct found at (%.6f, %.6f)\n", x, y);
+            } else {
+                Precinct* p = &app->precincts[i];
+                printf("%-20s %-10s %-8s %-10s\n", "ID", "Pop", "Dem%", "District");
+                printf("%-20s %-10d %-7.1f%% %d\n", 
+                       p->id, app->population[i], p->demShare * 100, app->district[i]);
+            }
+            printf("\n");
+            continue;
+        }
+        
         if (strncmp(input, "search ", 7) == 0) {
             char* term = input + 7;
             printf("\nSearch results for '%s':\n", term);
@@ -357,9 +415,9 @@ void show_manual_assignment(AppState* app) {
             int found = 0;
             for (int i = 0; i < app->precinctCount; i++) {
                 Precinct* p = &app->precincts[i];
-                if (strstr(p->id, term) != NULL || strstr(p->county, term) != NULL) {
+                if (strstr(p->id, term) != NULL || strstr(app->counties.names[app->countyId[i]], term) != NULL) {
                     printf("%-20s %-10d %-7.1f%% %d\n", 
-                           p->id, p->population, p->demShare * 100, p->district);
+                           p->id, app->population[i], p->demShare * 100, app->district[i]);
                     found++;
                     if (found >= 20) {
                         printf("... (showing first 20 matches)\n");
@@ -380,24 +438,43 @@ void show_manual_assignment(AppState* app) {
         
         if (sscanf(input, "%s %d", precinctId, &district) == 2) {
             /* Find precinct */
-            int found = 0;
-            for (int i = 0; i < app->precinctCount; i++) {
-                if (strcmp(app->precincts[i].id, precinctId) == 0) {
-                    if (district >= 0 && district <= app->currentPlan.numDistricts) {
-                        app->precincts[i].district = district;
-                        printf("Assigned precinct %s to district %d\n", precinctId, district);
-                    } else {
-                        printf("Invalid district number. Use 0-%d\n", app->currentPlan.numDistricts);
+            int i = find_precinct(app, precinctId);
+            if (i < 0) {
+                printf("Precinct '%s' not found.\n", precinctId);
+            } else if (district >= 0 && district <= app->currentPlan.numDistricts) {
+                int from = app->district[i];
+                int splits = from > 0 && from != district &&
+                             !contiguity_removal_ok(&app->contiguity, app->district, i);
+                int detached = district > 0 && from != district &&
+                               !contiguity_addition_ok(&app->contiguity, &app->ledger,
+                                                       app->district, i, district);
+                if (splits || detached) {
+                    if (splits) {
+                        printf("Warning: moving %s would split district %d.\n", precinctId, from);
+                    }
+                    if (detached) {
+                        printf("Warning: %s does not touch district %d.\n", precinctId, district);
+                    }
+                    char confirm[16];
+                    get_user_string("Assign anyway? (y/N): ", confirm, sizeof(confirm));
+                    if (confirm[0] != 'y' && confirm[0] != 'Y') {
+                        printf("Assignment cancelled.\n");
+                        continue;
                     }
-                    found = 1;
-                    break;
                 }
-            }
-            if (!found) {
-                printf("Precinct '%s' not found.\n", precinctId);
+                int journaled = journal_assign(app, i, district);
+                printf("Assigned precinct %s to district %d\n", precinctId, district);
+                if (!journaled) {
+                    stop_journaling(app);
+                }
+            } else {
+                printf("Invalid district number. Use 0-%d\n", app->currentPlan.numDistricts);
             }
         } else {
             printf("Usage: <precinct_id> <district_number>\n");
         }
     }
+    if (!journal_sync(app)) {
+        stop_journaling(app);
+    }
 }
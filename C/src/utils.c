@@ -10,6 +10,8 @@
 #define access _access
 #else
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #endif
 
 int ensure_directory(const char* path) {
@@ -91,16 +93,166 @@ char* read_file(const char* path) {
     return buffer;
 }
 
-/* Write string to file */
+/* Write string to file through a synced temp file renamed over path, so
+   readers never see a partly written file */
 int write_file(const char* path, const char* content) {
-    FILE* file = fopen(path, "wb");
+    char tempPath[MAX_PATH_LEN + 8];
+    int len = snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+    if (len < 0 || len >= (int)sizeof(tempPath)) {
+        return 0;
+    }
+    
+    FILE* file = fopen(tempPath, "wb");
     if (!file) {
         return 0;
     }
     
-    size_t len = strlen(content);
-    size_t written = fwrite(content, 1, len, file);
+    size_t size = strlen(content);
+    int ok = fwrite(content, 1, size, file) == size && sync_file(file);
+    ok = (fclose(file) == 0) && ok;
+    if (ok) {
+        ok = replace_file(tempPath, path);
+    }
+    if (!ok) {
+        remove(tempPath);
+    }
+    return ok;
+}
+
+/* Flush a stream's buffers through to the disk */
+int sync_file(FILE* file) {
+    if (fflush(file) != 0) return 0;
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+/* Rename a finished temp file over its destination in one step, so readers
+   see either the old file or the new one */
+int replace_file(const char* from, const char* to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+/* FNV-1a hash; pass 0 as seed to start a new hash */
+uint64_t hash_bytes(const void* data, size_t len, uint64_t seed) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint64_t hash = seed ? seed : 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/* Map a whole file read-only into memory */
+int map_file(const char* path, MappedFile* map) {
+    memset(map, 0, sizeof(MappedFile));
+#ifdef _WIN32
+    map->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (map->file == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+    
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(map->file, &size) || size.QuadPart == 0) {
+        CloseHandle(map->file);
+        return 0;
+    }
     
-    fclose(file);
-    return written == len;
+    map->mapping = CreateFileMappingA(map->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!map->mapping) {
+        CloseHandle(map->file);
+        return 0;
+    }
+    
+    map->data = (const unsigned char*)MapViewOfFile(map->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!map->data) {
+        CloseHandle(map->mapping);
+        CloseHandle(map->file);
+        return 0;
+    }
+    map->size = (size_t)size.QuadPart;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+    
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return 0;
+    }
+    map->data = (const unsigned char*)data;
+    map->size = (size_t)st.st_size;
+#endif
+    return 1;
+}
+
+/* Release a mapping created by map_file */
+void unmap_file(MappedFile* map) {
+    if (!map->data) return;
+#ifdef _WIN32
+    UnmapViewOfFile(map->data);
+    CloseHandle(map->mapping);
+    CloseHandle(map->file);
+#else
+    munmap((void*)map->data, map->size);
+#endif
+    memset(map, 0, sizeof(MappedFile));
+}
+
+/* Seconds on a monotonic clock, for measuring elapsed time */
+double monotonic_seconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, count;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (double)count.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+/* Mix a seed and a stream number into a nonzero generator state */
+uint32_t random_seed(uint32_t seed, uint32_t stream) {
+    uint64_t h = hash_bytes(&seed, sizeof(seed), 0);
+    h = hash_bytes(&stream, sizeof(stream), h);
+    uint32_t state = (uint32_t)(h ^ (h >> 32));
+    return state ? state : 0x9E3779B9u;
+}
+
+/* xorshift32: small and fast, plenty for randomized search */
+uint32_t random_next(uint32_t* state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/* Uniform double in [0, 1) */
+double random_unit(uint32_t* state) {
+    return (random_next(state) >> 8) * (1.0 / 16777216.0);
+}
+
+/* Uniform integer in [0, bound) by multiply-shift, avoiding a division */
+uint32_t random_below(uint32_t* state, uint32_t bound) {
+    return (uint32_t)(((uint64_t)random_next(state) * bound) >> 32);
 }